@@ -0,0 +1,242 @@
+#pragma once
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#ifdef HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+#include "gl_extensions.h"
+#include "gl_state.h"
+
+// The window the programs render to, shared by zad1 and zad2.
+//
+// Normally a GLFW window. In headless mode (build with -DHEADLESS_EGL and
+// link -lEGL) there is no window system at all: a surfaceless EGL context,
+// llvmpipe on servers without a GPU, renders into an FBO of the requested
+// size that takes the place of the window's framebuffer (the state cache
+// maps framebuffer 0 to it). The render loop is the same in both modes; a
+// headless run ends after a number of frames or when headlessDone returns
+// true, and its event calls return at once.
+//
+// Sizes are in framebuffer pixels, which on high-DPI screens are more than
+// the window's size in screen coordinates.
+class AppWindow {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Before open(): render offscreen for at most `frames` frames
+    void setHeadless(long frames)
+    {
+        headless = true;
+        maxFrames = frames;
+    }
+
+    // Headless only: make time() advance by exactly `seconds` per frame, so
+    // animations come out the same on every run
+    void setFixedTimeStep(double seconds) { fixedStep = seconds; }
+
+    // Headless only: checked by shouldClose(), ends the run early
+    std::function<bool()> headlessDone;
+
+    // Called with the new framebuffer size after the window was resized or
+    // moved to a screen of another scale; not while it is minimized
+    std::function<void(int, int)> onResize;
+
+    // Creates the window or context, makes it current and loads GL
+    bool open(int w, int h, const char* title)
+    {
+        width = w;
+        height = h;
+        start = Clock::now();
+        return headless ? openHeadless() : openWindow(title);
+    }
+
+    bool isHeadless() const { return headless; }
+
+    // Null when headless; callbacks only exist for a real window
+    GLFWwindow* glfw() const { return window; }
+
+    int framebufferWidth() const { return width; }
+    int framebufferHeight() const { return height; }
+
+    long frameCount() const { return frames; }
+
+    bool shouldClose() const
+    {
+        if (!headless)
+            return glfwWindowShouldClose(window);
+        return frames >= maxFrames || (headlessDone && headlessDone());
+    }
+
+    void swapBuffers()
+    {
+        ++frames;
+        if (!headless)
+            glfwSwapBuffers(window);
+        else
+            glFlush();
+    }
+
+    void pollEvents()
+    {
+        if (!headless)
+            glfwPollEvents();
+    }
+
+    void waitEvents()
+    {
+        if (!headless)
+            glfwWaitEvents();
+    }
+
+    void waitEventsTimeout(double seconds)
+    {
+        if (!headless)
+            glfwWaitEventsTimeout(seconds);
+    }
+
+    // Seconds since open(); glfwGetTime() for a window, so it matches the
+    // timestamps taken in GLFW callbacks
+    double time() const
+    {
+        if (!headless)
+            return glfwGetTime();
+        if (fixedStep > 0)
+            return frames * fixedStep;
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    void close()
+    {
+        if (!headless) {
+            if (window)
+                glfwDestroyWindow(window);
+            window = nullptr;
+            glfwTerminate();
+            return;
+        }
+#ifdef HEADLESS_EGL
+        if (context != EGL_NO_CONTEXT) {
+            glState().setDefaultFramebuffer(0);
+            glState().forgetFramebuffer(fbo);
+            glDeleteFramebuffers(1, &fbo);
+            glDeleteRenderbuffers(2, renderbuffers);
+            eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            eglDestroyContext(display, context);
+            context = EGL_NO_CONTEXT;
+        }
+        if (display != EGL_NO_DISPLAY)
+            eglTerminate(display);
+        display = EGL_NO_DISPLAY;
+#endif
+    }
+
+private:
+    bool headless = false;
+    long maxFrames = 0, frames = 0;
+    double fixedStep = 0;
+    int width = 0, height = 0;
+    Clock::time_point start;
+    GLFWwindow* window = nullptr;
+#ifdef HEADLESS_EGL
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+    GLuint fbo = 0, renderbuffers[2] = {};
+#endif
+
+    bool openWindow(const char* title)
+    {
+        if (!glfwInit()) {
+            std::cerr << "Failed to initialize GLFW\n";
+            return false;
+        }
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        window = glfwCreateWindow(width, height, title, nullptr, nullptr);
+        if (!window) {
+            std::cerr << "Failed to create GLFW window\n";
+            glfwTerminate();
+            return false;
+        }
+        glfwMakeContextCurrent(window);
+        if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+            std::cerr << "Failed to initialize GLAD\n";
+            return false;
+        }
+        glProcLoader = (GLADloadproc)glfwGetProcAddress;
+
+        glfwGetFramebufferSize(window, &width, &height);
+        glfwSetWindowUserPointer(window, this);
+        glfwSetFramebufferSizeCallback(window, [](GLFWwindow* w, int fbWidth, int fbHeight) {
+            AppWindow* self = static_cast<AppWindow*>(glfwGetWindowUserPointer(w));
+            if (fbWidth <= 0 || fbHeight <= 0 || (fbWidth == self->width && fbHeight == self->height))
+                return;
+            self->width = fbWidth;
+            self->height = fbHeight;
+            if (self->onResize)
+                self->onResize(fbWidth, fbHeight);
+        });
+        return true;
+    }
+
+#ifdef HEADLESS_EGL
+    bool openHeadless()
+    {
+        // The surfaceless platform needs no display server; fall back to
+        // the default display where it is missing
+        auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        display = getPlatformDisplay ? getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr)
+                                     : eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+            std::cerr << "Failed to initialize EGL\n";
+            return false;
+        }
+        eglBindAPI(EGL_OPENGL_API);
+        const EGLint configAttribs[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                                         EGL_NONE };
+        const EGLint contextAttribs[] = { EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+                                          EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                                          EGL_NONE };
+        EGLConfig config;
+        EGLint count = 0;
+        if (eglChooseConfig(display, configAttribs, &config, 1, &count) && count)
+            context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+        if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+            std::cerr << "Failed to create a surfaceless OpenGL 3.3 context\n";
+            return false;
+        }
+        if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+            std::cerr << "Failed to initialize GLAD\n";
+            return false;
+        }
+        glProcLoader = (GLADloadproc)eglGetProcAddress;
+
+        // Stands in for the window: RGBA8 color, 24-bit depth and 8-bit stencil
+        glGenRenderbuffers(2, renderbuffers);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glGenFramebuffers(1, &fbo);
+        glState().setDefaultFramebuffer(fbo);
+        glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "Headless framebuffer incomplete\n";
+            return false;
+        }
+        return true;
+    }
+#else
+    bool openHeadless()
+    {
+        std::cerr << "Headless rendering needs a build with -DHEADLESS_EGL -lEGL\n";
+        return false;
+    }
+#endif
+};
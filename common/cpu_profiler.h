@@ -0,0 +1,219 @@
+#pragma once
+#include <iostream>
+
+// Scoped CPU zones with Chrome trace export, shared by zad1 and zad2.
+//
+// Build with -DCPU_PROFILER to enable; otherwise the macros expand to
+// nothing and cost nothing.
+//
+//   PROFILE_THREAD("texture loader");  name the calling thread
+//   PROFILE_ZONE("draw");              time the enclosing scope
+//   PROFILE_FRAME();                   once per frame, records "frame"
+//
+// Each thread records into a ring of its own that only it writes, so
+// recording takes no lock: two clock reads and a store. When a ring is
+// full the oldest events are overwritten. A thread that exits hands its
+// ring back and the next new thread takes it over, events and track
+// included, so a worker started per job (the texture loader's) costs one
+// ring and shows as one track however many jobs run.
+//
+// cpuProfilerReport() writes the events still in the rings as Chrome
+// trace_event JSON (chrome://tracing, Perfetto) and prints count, mean,
+// p50, p95 and p99 of every zone; call it once the other threads are idle.
+
+#ifdef CPU_PROFILER
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class CpuProfiler;
+inline CpuProfiler& cpuProfiler();
+
+class CpuProfiler {
+public:
+    using Clock = std::chrono::steady_clock;
+    static const size_t ringSize = 16384; // events per thread, power of two
+
+    struct Event {
+        const char* name; // string literal
+        int64_t startNs, durationNs;
+    };
+
+    struct ThreadRing {
+        std::string name;
+        int id = 0;
+        std::atomic<size_t> head { 0 };
+        Event events[ringSize];
+
+        void record(const char* zone, int64_t start, int64_t end)
+        {
+            size_t h = head.load(std::memory_order_relaxed);
+            events[h & (ringSize - 1)] = { zone, start, end - start };
+            head.store(h + 1, std::memory_order_release);
+        }
+    };
+
+    int64_t now() const { return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - epoch).count(); }
+
+    // The calling thread's ring, taken on its first event: one an exited
+    // thread left behind, or a new one
+    ThreadRing& ring()
+    {
+        thread_local RingOwner mine;
+        if (!mine.ring) {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            if (freeRings.empty()) {
+                rings.emplace_back(new ThreadRing());
+                mine.ring = rings.back().get();
+                mine.ring->id = (int)rings.size();
+            } else {
+                mine.ring = freeRings.back();
+                freeRings.pop_back();
+            }
+            mine.ring->name = "thread " + std::to_string(mine.ring->id);
+        }
+        return *mine.ring;
+    }
+
+    void nameThread(const char* name) { ring().name = name; }
+
+    void markFrame()
+    {
+        thread_local int64_t lastFrame = -1;
+        int64_t t = now();
+        if (lastFrame >= 0)
+            ring().record("frame", lastFrame, t);
+        lastFrame = t;
+    }
+
+    bool writeChromeTrace(const char* path)
+    {
+        FILE* out = std::fopen(path, "w");
+        if (!out) {
+            std::cerr << "Cannot write " << path << "\n";
+            return false;
+        }
+        std::fprintf(out, "{\"traceEvents\":[\n");
+        bool first = true;
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (const std::unique_ptr<ThreadRing>& r : rings) {
+            std::fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                         first ? "" : ",\n", r->id, r->name.c_str());
+            first = false;
+            forEachEvent(*r, [&](const Event& e) {
+                std::fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                             e.name, r->id, e.startNs * 1e-3, e.durationNs * 1e-3);
+            });
+        }
+        std::fprintf(out, "\n],\"displayTimeUnit\":\"ms\"}\n");
+        std::fclose(out);
+        return true;
+    }
+
+    void printSummary(std::ostream& out)
+    {
+        std::map<std::string, std::vector<double>> zones; // ms
+        {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            for (const std::unique_ptr<ThreadRing>& r : rings)
+                forEachEvent(*r, [&](const Event& e) { zones[e.name].push_back(e.durationNs * 1e-6); });
+        }
+        char line[256];
+        for (auto& zone : zones) {
+            std::vector<double>& ms = zone.second;
+            std::sort(ms.begin(), ms.end());
+            double sum = 0;
+            for (double d : ms)
+                sum += d;
+            auto percentile = [&](double p) { return ms[std::min(ms.size() - 1, (size_t)(p * ms.size()))]; };
+            std::snprintf(line, sizeof(line), "CPU %-16s %7zu x, mean %.3f ms, p50 %.3f, p95 %.3f, p99 %.3f\n",
+                          zone.first.c_str(), ms.size(), sum / ms.size(), percentile(0.50), percentile(0.95),
+                          percentile(0.99));
+            out << line;
+        }
+    }
+
+private:
+    // Returns the ring when its thread exits
+    struct RingOwner {
+        ThreadRing* ring = nullptr;
+        ~RingOwner()
+        {
+            if (ring)
+                cpuProfiler().releaseRing(ring);
+        }
+    };
+
+    Clock::time_point epoch = Clock::now();
+    std::mutex registryMutex;
+    std::vector<std::unique_ptr<ThreadRing>> rings; // kept after their thread exits
+    std::vector<ThreadRing*> freeRings;             // of exited threads, for the next new ones
+
+    void releaseRing(ThreadRing* r)
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        freeRings.push_back(r);
+    }
+
+    template <typename F>
+    static void forEachEvent(const ThreadRing& r, F f)
+    {
+        size_t head = r.head.load(std::memory_order_acquire);
+        for (size_t i = head > ringSize ? head - ringSize : 0; i < head; ++i)
+            f(r.events[i & (ringSize - 1)]);
+    }
+};
+
+inline CpuProfiler& cpuProfiler()
+{
+    static CpuProfiler profiler;
+    return profiler;
+}
+
+class CpuZone {
+public:
+    explicit CpuZone(const char* name) : name(name), start(cpuProfiler().now()) {}
+    ~CpuZone() { cpuProfiler().ring().record(name, start, cpuProfiler().now()); }
+    CpuZone(const CpuZone&) = delete;
+    CpuZone& operator=(const CpuZone&) = delete;
+
+private:
+    const char* name;
+    int64_t start;
+};
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_ZONE(name) CpuZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FRAME() cpuProfiler().markFrame()
+#define PROFILE_THREAD(name) cpuProfiler().nameThread(name)
+
+// At exit: the summary, and the trace if `tracePath` is set
+inline void cpuProfilerReport(const char* tracePath, std::ostream& out)
+{
+    cpuProfiler().printSummary(out);
+    if (tracePath && cpuProfiler().writeChromeTrace(tracePath))
+        out << "CPU trace written to " << tracePath << "\n";
+}
+
+#else
+
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_FRAME() ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+
+inline void cpuProfilerReport(const char* tracePath, std::ostream&)
+{
+    if (tracePath)
+        std::cerr << "CPU tracing needs a build with -DCPU_PROFILER\n";
+}
+
+#endif
@@ -0,0 +1,219 @@
+#pragma once
+#include <glad/glad.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include "gl_state.h"
+#include "shader_manager.h"
+
+// Dynamic resolution scaling, shared by zad1 and zad2.
+//
+// Frames are drawn into an offscreen color texture and stretched, linearly
+// filtered, over the window by one full-screen triangle. The texture is
+// allocated at the window's size and only a scaled rectangle of it is used,
+// so a new scale costs a different viewport rather than a reallocation.
+// At full scale the target is skipped and frames go straight to the window.
+// Between begin() and end() the state cache maps framebuffer 0 to the
+// target, so code that binds 0 to get back from its own FBO (the virtual
+// texture's feedback pass, say) still lands in the right place.
+//
+// The upscale is a draw rather than glBlitFramebuffer because software
+// rasterizers take a slow path for scaled blits: on llvmpipe one cost more
+// than drawing the whole frame at full size.
+//
+// endFrame() goes after the swap and feeds the controller: the time from
+// begin() to then, or the GPU frame time when that is larger, smoothed over
+// a few frames. Fill cost follows the pixel count, which goes with the
+// square of the scale, so a frame `f` times over budget scales by
+// 1/sqrt(f) at once; the scale grows back in small steps once frames stay
+// well under budget. Under vsync the swap waits for the display and counts
+// as frame time, so leave the budget some room above the refresh interval
+// or pace uncapped or with a cap.
+class DynamicResolution {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr float minScale = 0.25f;
+
+    // With the context current; a budget of 0 leaves rendering at window
+    // size. The upscale shader is submitted to `shaders` and picked up by
+    // the first end().
+    void create(int windowWidth, int windowHeight, double budget, ShaderManager& shaders)
+    {
+        budgetMs = budget;
+        if (budgetMs <= 0)
+            return;
+        shaderManager = &shaders;
+        upscaleShader = shaders.submit("upscale", upscaleVertexSource, upscaleFragmentSource);
+        glGenTextures(1, &colorTex);
+        glGenFramebuffers(1, &fbo);
+        glGenVertexArrays(1, &vao); // no attributes, the triangle comes from gl_VertexID
+        resize(windowWidth, windowHeight);
+        glState().bindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTex, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "Dynamic resolution target incomplete, rendering at window size\n";
+            destroy();
+        }
+        glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    bool enabled() const { return fbo != 0; }
+
+    // After the window's framebuffer changed size
+    void resize(int windowWidth, int windowHeight)
+    {
+        windowW = windowWidth;
+        windowH = windowHeight;
+        if (!colorTex)
+            return;
+        glState().bindTexture(GL_TEXTURE_2D, colorTex);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, windowW, windowH, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    // The size frames are drawn at, the window's when disabled
+    int renderWidth() const { return enabled() ? scaled(windowW) : windowW; }
+    int renderHeight() const { return enabled() ? scaled(windowH) : windowH; }
+
+    // Before the frame's first draw: framebuffer 0 and the viewport are the
+    // scaled render target until end()
+    void begin()
+    {
+        frameStart = Clock::now();
+        redirected = enabled() && scale < 1.0f;
+        if (!redirected)
+            return;
+        windowFbo = glState().defaultFramebuffer();
+        glState().setDefaultFramebuffer(fbo);
+        glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, renderWidth(), renderHeight());
+    }
+
+    // After the last draw, before the frame is captured or swapped
+    void end()
+    {
+        if (!redirected)
+            return;
+        redirected = false;
+        glState().setDefaultFramebuffer(windowFbo);
+        glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, windowW, windowH);
+        if (!program) {
+            program = shaderManager->program(upscaleShader);
+            scaleLocation = glGetUniformLocation(program, "uScale");
+            limitLocation = glGetUniformLocation(program, "uLimit");
+        }
+        glState().useProgram(program);
+        float w = (float)renderWidth(), h = (float)renderHeight();
+        glUniform2f(scaleLocation, w / windowW, h / windowH);
+        // Linear filtering must not reach the unused texels past the edge
+        glUniform2f(limitLocation, (w - 0.5f) / windowW, (h - 0.5f) / windowH);
+        glState().activeTexture(GL_TEXTURE0);
+        glState().bindTexture(GL_TEXTURE_2D, colorTex);
+        glState().bindVertexArray(vao);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+
+    // After the swap; `gpuFrameMs` is 0 without GPU timing
+    void endFrame(double gpuFrameMs = 0)
+    {
+        if (!enabled())
+            return;
+        double ms = std::max(std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count(), gpuFrameMs);
+        smoothedMs = smoothedMs > 0 ? smoothedMs + smoothing * (ms - smoothedMs) : ms;
+        ++frames;
+        scaleSum += scale;
+        lowestScale = std::min(lowestScale, scale);
+        if (++framesSinceChange < settleFrames)
+            return;
+
+        float target = scale * (float)std::sqrt(budgetMs / smoothedMs);
+        float next = scale;
+        if (smoothedMs > budgetMs)
+            next = std::max(target, minScale);
+        else if (smoothedMs < budgetMs * growBelow)
+            next = std::min({ target, scale + maxGrowth, 1.0f });
+        if (std::fabs(next - scale) < minChange && next != 1.0f && next != minScale)
+            return;
+        if (next != scale) {
+            scale = next;
+            framesSinceChange = 0;
+            ++changes;
+        }
+    }
+
+    float currentScale() const { return scale; }
+
+    void printStats(std::ostream& out) const
+    {
+        if (!frames)
+            return;
+        char line[200];
+        std::snprintf(line, sizeof(line),
+                      "Dynamic resolution: budget %.1f ms, scale mean %.2f, min %.2f, %zu changes, now %dx%d of %dx%d\n",
+                      budgetMs, scaleSum / frames, lowestScale, changes, scaled(windowW), scaled(windowH), windowW,
+                      windowH);
+        out << line;
+    }
+
+    void destroy()
+    {
+        glState().forgetFramebuffer(fbo);
+        glState().forgetTexture(colorTex);
+        glState().forgetVertexArray(vao);
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteTextures(1, &colorTex);
+        glDeleteVertexArrays(1, &vao);
+        glDeleteProgram(program);
+        fbo = colorTex = vao = program = 0;
+    }
+
+private:
+    static constexpr double smoothing = 0.25; // weight of the newest frame
+    static constexpr long settleFrames = 8;   // frames at a new scale before judging it
+    static constexpr double growBelow = 0.8;  // of the budget
+    static constexpr float maxGrowth = 0.05f; // per change
+    static constexpr float minChange = 0.02f;
+
+    // One triangle covering the window; uScale picks the drawn rectangle
+    static constexpr const char* upscaleVertexSource = R"(#version 330 core
+uniform vec2 uScale;
+out vec2 TexCoords;
+void main()
+{
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+    TexCoords = corner * uScale;
+})";
+
+    static constexpr const char* upscaleFragmentSource = R"(#version 330 core
+in vec2 TexCoords;
+out vec4 FragColor;
+uniform sampler2D uFrame;
+uniform vec2 uLimit;
+void main()
+{
+    FragColor = texture(uFrame, min(TexCoords, uLimit));
+})";
+
+    ShaderManager* shaderManager = nullptr;
+    int upscaleShader = -1;
+    GLuint fbo = 0, colorTex = 0, vao = 0, program = 0, windowFbo = 0;
+    GLint scaleLocation = -1, limitLocation = -1;
+    bool redirected = false; // between begin() and end() of a scaled frame
+    int windowW = 0, windowH = 0;
+    double budgetMs = 0, smoothedMs = 0;
+    float scale = 1.0f, lowestScale = 1.0f;
+    Clock::time_point frameStart;
+    long framesSinceChange = 0;
+    size_t frames = 0, changes = 0;
+    double scaleSum = 0;
+
+    int scaled(int size) const { return std::max(1, (int)std::lround(size * scale)); }
+};
@@ -0,0 +1,247 @@
+#pragma once
+#include <glad/glad.h>
+#include <sys/stat.h>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "gl_state.h"
+
+// Asynchronous capture of rendered frames to PPM files, shared by zad1 and
+// zad2.
+//
+// capture() goes after the last draw of a frame, before the swap. It starts
+// a glReadPixels into the next of a small ring of GL_PIXEL_PACK_BUFFERs and
+// puts a fence behind it, so the call returns at once and the copy runs on
+// the GPU's timeline. Buffers are mapped only once their fence has signalled,
+// normally ringSize - 1 frames later; the pixels are copied out and a writer
+// thread flips them and writes <dir>/frame_<n>.ppm. The render thread only
+// waits when the GPU is a whole ring behind or the disk cannot keep up, and
+// counts those waits as stalls.
+class FrameCapture {
+public:
+    static const size_t ringSize = 3;
+    // Frames copied out but not yet written before the render thread waits
+    static const size_t maxQueued = 8;
+
+    ~FrameCapture() { stopWriter(); }
+
+    // With the context current; `dir` is created if missing
+    bool start(const std::string& directory, int w, int h)
+    {
+        dir = directory;
+        width = w;
+        height = h;
+        mkdir(dir.c_str(), 0755);
+        size_t size = frameBytes();
+        for (Slot& slot : ring) {
+            glGenBuffers(1, &slot.buffer);
+            glState().bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+            glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+        }
+        glState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        stopping = false;
+        writer = std::thread(&FrameCapture::writeFrames, this);
+        return true;
+    }
+
+    bool active() const { return writer.joinable(); }
+
+    // Reads back the current frame of the window's framebuffer; `frame`
+    // numbers the file
+    void capture(long frame)
+    {
+        if (!active())
+            return;
+        collect(false);
+        Slot& slot = ring[next];
+        if (slot.fence) {
+            ++gpuStalls; // the GPU is a whole ring behind
+            if (!readBack(slot, true)) {
+                glDeleteSync(slot.fence); // not done after a second, give the frame up
+                slot.fence = nullptr;
+            }
+        }
+        glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
+        glState().bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.frame = frame;
+        next = (next + 1) % ringSize;
+        ++captured;
+    }
+
+    // After the window's framebuffer changed size: frames in flight are
+    // read back at the old size first, later ones use the new
+    void resize(int w, int h)
+    {
+        if (!active() || (w == width && h == height))
+            return;
+        collect(true);
+        width = w;
+        height = h;
+        for (Slot& slot : ring) {
+            glState().bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+            glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes(), nullptr, GL_STREAM_READ);
+        }
+        glState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    // With the context current: read back what is still in flight, write
+    // everything out and release the buffers
+    void finish()
+    {
+        if (!active())
+            return;
+        collect(true);
+        stopWriter();
+        for (Slot& slot : ring) {
+            glState().forgetBuffer(slot.buffer);
+            glDeleteBuffers(1, &slot.buffer);
+            slot.buffer = 0;
+        }
+    }
+
+    void printStats(std::ostream& out) const
+    {
+        if (captured)
+            out << "Captured " << captured << " frames to " << dir << "/, " << written << " written, "
+                << gpuStalls << " waits for the GPU, " << writerStalls << " for the writer\n";
+    }
+
+private:
+    struct Slot {
+        GLuint buffer = 0;
+        GLsync fence = nullptr;
+        long frame = 0;
+    };
+
+    struct Pending {
+        long frame;
+        int width, height;
+        std::vector<unsigned char> pixels; // RGBA, bottom row first
+    };
+
+    std::string dir;
+    int width = 0, height = 0;
+    Slot ring[ringSize];
+    size_t next = 0; // the oldest slot in flight, if any
+    size_t captured = 0, written = 0, gpuStalls = 0, writerStalls = 0;
+
+    // Writer thread state
+    std::thread writer;
+    std::mutex queueMutex;
+    std::condition_variable queueCv;
+    std::deque<Pending> queue;
+    std::vector<std::vector<unsigned char>> spare; // written frames' storage
+    bool stopping = false;
+
+    size_t frameBytes() const { return (size_t)width * height * 4; }
+
+    // Oldest first, so files are queued in frame order; `wait` blocks on
+    // each fence instead of stopping at the first unsignalled one
+    void collect(bool wait)
+    {
+        for (size_t i = 0; i < ringSize; ++i) {
+            Slot& slot = ring[(next + i) % ringSize];
+            if (slot.fence && !readBack(slot, wait))
+                return;
+        }
+    }
+
+    bool readBack(Slot& slot, bool wait)
+    {
+        GLuint64 timeout = wait ? 1000000000ull : 0; // 1 s
+        GLenum status = glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, timeout);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            return false;
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+
+        Pending frame { slot.frame, width, height, {} };
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            if (queue.size() >= maxQueued) {
+                ++writerStalls; // the disk is behind
+                queueCv.wait(lock, [&] { return queue.size() < maxQueued; });
+            }
+            if (!spare.empty()) {
+                frame.pixels.swap(spare.back());
+                spare.pop_back();
+            }
+        }
+        frame.pixels.resize(frameBytes());
+        glState().bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        if (void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameBytes(), GL_MAP_READ_BIT)) {
+            std::memcpy(frame.pixels.data(), data, frameBytes());
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            queue.push_back(std::move(frame));
+        }
+        queueCv.notify_all();
+        return true;
+    }
+
+    void stopWriter()
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stopping = true;
+        }
+        queueCv.notify_all();
+        if (writer.joinable())
+            writer.join();
+    }
+
+    // Writer thread: binary PPM, top row first, alpha dropped
+    void writeFrames()
+    {
+        std::vector<unsigned char> row;
+        for (;;) {
+            Pending frame;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                queueCv.wait(lock, [&] { return stopping || !queue.empty(); });
+                if (queue.empty())
+                    return;
+                frame = std::move(queue.front());
+                queue.pop_front();
+            }
+            queueCv.notify_all();
+
+            char name[32];
+            std::snprintf(name, sizeof(name), "/frame_%06ld.ppm", frame.frame);
+            std::string path = dir + name;
+            if (FILE* out = std::fopen(path.c_str(), "wb")) {
+                std::fprintf(out, "P6\n%d %d\n255\n", frame.width, frame.height);
+                row.resize((size_t)frame.width * 3);
+                for (int y = frame.height - 1; y >= 0; --y) {
+                    const unsigned char* src = frame.pixels.data() + (size_t)y * frame.width * 4;
+                    for (int x = 0; x < frame.width; ++x) {
+                        row[x * 3 + 0] = src[x * 4 + 0];
+                        row[x * 3 + 1] = src[x * 4 + 1];
+                        row[x * 3 + 2] = src[x * 4 + 2];
+                    }
+                    std::fwrite(row.data(), 1, row.size(), out);
+                }
+                std::fclose(out);
+                ++written;
+            } else {
+                std::cerr << "Cannot write " << path << "\n";
+            }
+
+            std::lock_guard<std::mutex> lock(queueMutex);
+            spare.push_back(std::move(frame.pixels));
+        }
+    }
+};
@@ -0,0 +1,177 @@
+#pragma once
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Frame pacing and frame-time statistics, shared by zad1 and zad2.
+//
+//   vsync     swap interval 1, the display's refresh rate
+//   adaptive  swap interval -1: vsync, but a late frame is shown at once
+//             instead of waiting a whole refresh; falls back to vsync
+//             without EXT_swap_control_tear
+//   uncapped  swap interval 0, as fast as possible, for benchmarks
+//   <fps>     swap interval 0 and a limiter that sleeps until shortly
+//             before the deadline and spins the rest, since sleeps
+//             overshoot by up to a scheduler tick
+//
+// endFrame() goes right after glfwSwapBuffers. It applies the cap and
+// returns the time since the previous frame, which animations use as dt.
+enum class PacingMode { Vsync, Adaptive, Uncapped, Capped };
+
+struct FrameTimeStats {
+    size_t frames = 0;
+    double meanMs = 0, p50Ms = 0, p95Ms = 0, p99Ms = 0, maxMs = 0;
+};
+
+// The last historySize durations of something measured once per frame
+class FrameTimeHistory {
+public:
+    static const size_t historySize = 4096;
+
+    void record(double ms)
+    {
+        if (frameMs.size() < historySize)
+            frameMs.push_back(ms);
+        else
+            frameMs[recorded % historySize] = ms;
+        ++recorded;
+    }
+
+    void clear()
+    {
+        frameMs.clear();
+        recorded = 0;
+    }
+
+    FrameTimeStats stats() const
+    {
+        FrameTimeStats s;
+        std::vector<double> sorted(frameMs);
+        if (sorted.empty())
+            return s;
+        std::sort(sorted.begin(), sorted.end());
+        s.frames = recorded;
+        for (double ms : sorted)
+            s.meanMs += ms;
+        s.meanMs /= sorted.size();
+        auto percentile = [&](double p) { return sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))]; };
+        s.p50Ms = percentile(0.50);
+        s.p95Ms = percentile(0.95);
+        s.p99Ms = percentile(0.99);
+        s.maxMs = sorted.back();
+        return s;
+    }
+
+private:
+    std::vector<double> frameMs; // ring
+    size_t recorded = 0;
+};
+
+class FramePacer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Accepts vsync, adaptive, uncapped or a frame rate cap
+    bool parse(const char* arg)
+    {
+        if (!std::strcmp(arg, "vsync"))
+            mode = PacingMode::Vsync;
+        else if (!std::strcmp(arg, "adaptive"))
+            mode = PacingMode::Adaptive;
+        else if (!std::strcmp(arg, "uncapped"))
+            mode = PacingMode::Uncapped;
+        else if (std::atof(arg) > 0) {
+            mode = PacingMode::Capped;
+            fpsCap = std::atof(arg);
+        } else
+            return false;
+        return true;
+    }
+
+    // With the window's context current. Without a window (headless
+    // rendering) there is nothing to sync to, so vsync runs uncapped.
+    void begin(bool hasWindow = true)
+    {
+        if (!hasWindow && mode != PacingMode::Capped)
+            mode = PacingMode::Uncapped;
+        if (mode == PacingMode::Adaptive && !glfwExtensionSupported("GLX_EXT_swap_control_tear") &&
+            !glfwExtensionSupported("WGL_EXT_swap_control_tear"))
+            mode = PacingMode::Vsync;
+        switch (hasWindow ? mode : PacingMode::Capped) {
+        case PacingMode::Vsync:    glfwSwapInterval(1); break;
+        case PacingMode::Adaptive: glfwSwapInterval(-1); break;
+        case PacingMode::Uncapped: glfwSwapInterval(0); break;
+        case PacingMode::Capped:   if (hasWindow) glfwSwapInterval(0); break;
+        }
+        last = deadline = Clock::now();
+        history.clear();
+    }
+
+    double endFrame()
+    {
+        if (mode == PacingMode::Capped)
+            waitForDeadline();
+        Clock::time_point now = Clock::now();
+        double seconds = std::chrono::duration<double>(now - last).count();
+        last = now;
+        history.record(seconds * 1e3);
+        return seconds;
+    }
+
+    // After the loop slept waiting for events: the next frame is timed from
+    // now, so idle time does not show up as frame time
+    void restartFrame() { last = deadline = Clock::now(); }
+
+    PacingMode activeMode() const { return mode; }
+
+    // Over the last FrameTimeHistory::historySize frames
+    FrameTimeStats stats() const { return history.stats(); }
+
+    void printStats(std::ostream& out) const
+    {
+        static const char* names[] = { "vsync", "adaptive", "uncapped", "capped" };
+        FrameTimeStats s = stats();
+        if (!s.frames)
+            return;
+        char name[32], line[256];
+        if (mode == PacingMode::Capped)
+            std::snprintf(name, sizeof(name), "capped at %g fps", fpsCap);
+        else
+            std::snprintf(name, sizeof(name), "%s", names[(int)mode]);
+        std::snprintf(line, sizeof(line),
+                      "Frame pacing %s: %zu frames, %.1f fps, mean %.2f ms, p50 %.2f, p95 %.2f, p99 %.2f, max %.2f\n",
+                      name, s.frames, s.meanMs > 0 ? 1e3 / s.meanMs : 0.0, s.meanMs, s.p50Ms, s.p95Ms,
+                      s.p99Ms, s.maxMs);
+        out << line;
+    }
+
+private:
+    // Sleeps end up to this late, the limiter spins for the rest
+    static constexpr std::chrono::microseconds spinMargin { 2000 };
+
+    PacingMode mode = PacingMode::Vsync;
+    double fpsCap = 60.0;
+    Clock::time_point last, deadline;
+    FrameTimeHistory history;
+
+    void waitForDeadline()
+    {
+        Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / fpsCap));
+        deadline += period;
+        Clock::time_point now = Clock::now();
+        if (deadline < now - period) {
+            deadline = now; // a stall, don't try to catch up with a burst of frames
+            return;
+        }
+        if (deadline - now > spinMargin)
+            std::this_thread::sleep_for(deadline - now - spinMargin);
+        while (Clock::now() < deadline)
+            ;
+    }
+};
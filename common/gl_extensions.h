@@ -0,0 +1,37 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstring>
+
+// Extensions beyond the GL 3.3 core that glad was generated for, shared by
+// zad1 and zad2. Their entry points are looked up at run time through the
+// loader the context was created with (glfwGetProcAddress or
+// eglGetProcAddress), which AppWindow records in glProcLoader.
+
+inline GLADloadproc glProcLoader = nullptr;
+
+// Null when the driver does not export `name`
+inline void* glProc(const char* name)
+{
+    return glProcLoader ? glProcLoader(name) : nullptr;
+}
+
+// Context version as major * 10 + minor, 33 for OpenGL 3.3
+inline int glContextVersion()
+{
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    return major * 10 + minor;
+}
+
+inline bool hasGLExtension(const char* name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i) {
+        const char* ext = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+        if (ext && !std::strcmp(ext, name))
+            return true;
+    }
+    return false;
+}
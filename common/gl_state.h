@@ -0,0 +1,247 @@
+#pragma once
+#include <glad/glad.h>
+
+// Shadow copy of the GL binding state, shared by zad1 and zad2.
+//
+// Binding calls go through the cache instead of straight to GL; a call that
+// would bind what is already bound is dropped. Every call is counted as
+// issued or skipped, and endFrame() keeps the counts of the finished frame.
+//
+// The cache only knows what went through it. Code that binds with raw GL
+// calls or hands the context to something else must call invalidate()
+// afterwards; deleted objects are reported with the forget* functions,
+// because GL unbinds them implicitly.
+class GLStateCache {
+public:
+    static const unsigned maxTextureUnits = 16;
+    static const unsigned maxUniformBindings = 16;
+
+    struct Counts {
+        unsigned issued = 0;
+        unsigned skipped = 0;
+    };
+
+    GLStateCache() { invalidate(); }
+
+    void useProgram(GLuint program)
+    {
+        if (update(currentProgram, program))
+            glUseProgram(program);
+    }
+
+    // Also drops the element buffer binding, which is part of the VAO
+    void bindVertexArray(GLuint vao)
+    {
+        if (update(currentVertexArray, vao)) {
+            glBindVertexArray(vao);
+            buffers[ElementArray] = unknown;
+        }
+    }
+
+    // Takes GL_TEXTUREi like glActiveTexture
+    void activeTexture(GLenum unit)
+    {
+        if (update(currentUnit, unit - GL_TEXTURE0))
+            glActiveTexture(unit);
+    }
+
+    // Only GL_TEXTURE_2D is shadowed; other targets always reach GL
+    void bindTexture(GLenum target, GLuint texture)
+    {
+        if (target != GL_TEXTURE_2D || currentUnit >= maxTextureUnits) {
+            ++frame.issued;
+            glBindTexture(target, texture);
+            return;
+        }
+        if (update(textures[currentUnit], texture))
+            glBindTexture(target, texture);
+    }
+
+    void bindBuffer(GLenum target, GLuint buffer)
+    {
+        int slot = bufferSlot(target);
+        if (slot < 0) {
+            ++frame.issued;
+            glBindBuffer(target, buffer);
+            return;
+        }
+        if (update(buffers[slot], buffer))
+            glBindBuffer(target, buffer);
+    }
+
+    // Indexed binding of a uniform buffer range; like GL this also sets the
+    // generic GL_UNIFORM_BUFFER binding when it is issued
+    void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+    {
+        if (target != GL_UNIFORM_BUFFER || index >= maxUniformBindings) {
+            ++frame.issued;
+            glBindBufferRange(target, index, buffer, offset, size);
+            forgetBinding(target);
+            return;
+        }
+        UniformRange& range = uniformRanges[index];
+        if (range.buffer == buffer && range.offset == offset && range.size == size) {
+            ++frame.skipped;
+            return;
+        }
+        range = { buffer, offset, size };
+        buffers[UniformBuffer] = buffer;
+        ++frame.issued;
+        glBindBufferRange(target, index, buffer, offset, size);
+    }
+
+    // Whole-buffer variant of bindBufferRange
+    void bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+    {
+        if (target != GL_UNIFORM_BUFFER || index >= maxUniformBindings) {
+            ++frame.issued;
+            glBindBufferBase(target, index, buffer);
+            forgetBinding(target);
+            return;
+        }
+        UniformRange& range = uniformRanges[index];
+        if (range.buffer == buffer && range.size == wholeBuffer) {
+            ++frame.skipped;
+            return;
+        }
+        range = { buffer, 0, wholeBuffer };
+        buffers[UniformBuffer] = buffer;
+        ++frame.issued;
+        glBindBufferBase(target, index, buffer);
+    }
+
+    // Framebuffer 0 stands for the window's framebuffer, which headless
+    // rendering replaces with an FBO (see setDefaultFramebuffer)
+    void bindFramebuffer(GLenum target, GLuint framebuffer)
+    {
+        if (!framebuffer)
+            framebuffer = defaultFbo;
+        if (target != GL_FRAMEBUFFER) {
+            ++frame.issued;
+            glBindFramebuffer(target, framebuffer);
+            currentFramebuffer = unknown;
+            return;
+        }
+        if (update(currentFramebuffer, framebuffer))
+            glBindFramebuffer(target, framebuffer);
+    }
+
+    void setDefaultFramebuffer(GLuint framebuffer)
+    {
+        defaultFbo = framebuffer;
+        currentFramebuffer = unknown;
+    }
+
+    GLuint defaultFramebuffer() const { return defaultFbo; }
+
+    void forgetProgram(GLuint program) { forget(currentProgram, program); }
+
+    void forgetVertexArray(GLuint vao)
+    {
+        if (currentVertexArray == vao)
+            currentVertexArray = buffers[ElementArray] = unknown;
+    }
+
+    void forgetFramebuffer(GLuint framebuffer) { forget(currentFramebuffer, framebuffer); }
+
+    void forgetTexture(GLuint texture)
+    {
+        for (GLuint& bound : textures)
+            forget(bound, texture);
+    }
+
+    void forgetBuffer(GLuint buffer)
+    {
+        for (GLuint& bound : buffers)
+            forget(bound, buffer);
+        for (UniformRange& range : uniformRanges)
+            if (range.buffer == buffer)
+                range.buffer = unknown;
+    }
+
+    // Assume nothing about the current bindings
+    void invalidate()
+    {
+        currentProgram = currentVertexArray = currentUnit = currentFramebuffer = unknown;
+        for (GLuint& bound : textures)
+            bound = unknown;
+        for (GLuint& bound : buffers)
+            bound = unknown;
+        for (UniformRange& range : uniformRanges)
+            range.buffer = unknown;
+    }
+
+    // Call once per frame, after the last draw
+    void endFrame()
+    {
+        lastFrame = frame;
+        frame = Counts();
+    }
+
+    // Counts of the last finished frame
+    const Counts& lastFrameCounts() const { return lastFrame; }
+
+private:
+    enum BufferSlot { ArrayBuffer, ElementArray, PixelPack, PixelUnpack, UniformBuffer, BufferSlotCount };
+
+    // No object name is ever ~0, so a binding set to it always reaches GL
+    static const GLuint unknown = ~0u;
+    static const GLsizeiptr wholeBuffer = -1;
+
+    struct UniformRange {
+        GLuint buffer;
+        GLintptr offset;
+        GLsizeiptr size;
+    };
+
+    GLuint currentProgram, currentVertexArray, currentUnit, currentFramebuffer;
+    GLuint defaultFbo = 0;
+    GLuint textures[maxTextureUnits];
+    GLuint buffers[BufferSlotCount];
+    UniformRange uniformRanges[maxUniformBindings];
+    Counts frame, lastFrame;
+
+    static int bufferSlot(GLenum target)
+    {
+        switch (target) {
+        case GL_ARRAY_BUFFER:         return ArrayBuffer;
+        case GL_ELEMENT_ARRAY_BUFFER: return ElementArray;
+        case GL_PIXEL_PACK_BUFFER:    return PixelPack;
+        case GL_PIXEL_UNPACK_BUFFER:  return PixelUnpack;
+        case GL_UNIFORM_BUFFER:       return UniformBuffer;
+        default:                      return -1;
+        }
+    }
+
+    // Returns true if the call has to be issued
+    bool update(GLuint& bound, GLuint value)
+    {
+        if (bound == value) {
+            ++frame.skipped;
+            return false;
+        }
+        bound = value;
+        ++frame.issued;
+        return true;
+    }
+
+    void forgetBinding(GLenum target)
+    {
+        int slot = bufferSlot(target);
+        if (slot >= 0)
+            buffers[slot] = unknown;
+    }
+
+    static void forget(GLuint& bound, GLuint name)
+    {
+        if (bound == name)
+            bound = unknown;
+    }
+};
+
+// The programs use a single GL context, so one cache is enough
+inline GLStateCache& glState()
+{
+    static GLStateCache cache;
+    return cache;
+}
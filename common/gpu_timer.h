@@ -0,0 +1,201 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "frame_pacer.h"
+
+// GPU time of a frame and of named zones inside it, shared by zad1 and zad2.
+//
+// Every zone is a pair of glQueryCounter(GL_TIMESTAMP) queries, so zones
+// may nest (GL_TIME_ELAPSED queries cannot). Each of the last
+// framesInFlight frames has its own set of query objects; a frame's results
+// are read when its set comes round again, by which time the GPU has long
+// finished it, so reading never waits. A frame whose results are still not
+// there is dropped and counted as late.
+//
+// Zones that occur several times in a frame are summed. Durations go into
+// the same FrameTimeHistory as the CPU frame times, and printStats() sets
+// the GPU frame time against the CPU one.
+//
+//   gpuTimer.beginFrame();
+//   { GpuZone zone(gpuTimer, "shapes"); ...draw... }
+//   gpuTimer.endFrame();
+//
+// Until create() is called all of this does nothing.
+class GpuTimer {
+public:
+    static const unsigned framesInFlight = 3;
+    static const unsigned maxZones = 15; // per frame, besides the frame itself
+
+    // With the context current
+    void create()
+    {
+        for (FrameQueries& f : frames)
+            glGenQueries(2 * (maxZones + 1), f.queries);
+        zoneNames.assign(1, "frame");
+        history.assign(1, FrameTimeHistory());
+        active = true;
+    }
+
+    bool enabled() const { return active; }
+
+    void beginFrame()
+    {
+        if (!active)
+            return;
+        current = (current + 1) % framesInFlight;
+        readResults(frames[current], false);
+        frames[current].count = 0;
+        frames[current].pending = true;
+        glQueryCounter(frames[current].queries[0], GL_TIMESTAMP);
+        frames[current].zoneOf[0] = 0;
+        frames[current].ended[0] = false;
+        ++frames[current].count;
+    }
+
+    void endFrame() { end(active ? 0 : -1); }
+
+    // Returns a handle for end(), -1 if the frame has no room left
+    int begin(const char* name)
+    {
+        if (!active || !frames[current].pending || frames[current].count > maxZones)
+            return -1;
+        FrameQueries& f = frames[current];
+        int record = (int)f.count++;
+        f.zoneOf[record] = zoneIndex(name);
+        f.ended[record] = false;
+        glQueryCounter(f.queries[2 * record], GL_TIMESTAMP);
+        return record;
+    }
+
+    void end(int record)
+    {
+        if (record < 0)
+            return;
+        FrameQueries& f = frames[current];
+        glQueryCounter(f.queries[2 * record + 1], GL_TIMESTAMP);
+        f.ended[record] = true;
+    }
+
+    // Most recent GPU frame time in milliseconds, 0 before the first result
+    double lastFrameMs() const { return lastMs; }
+
+    FrameTimeStats stats(const char* name) const
+    {
+        for (size_t i = 0; i < zoneNames.size(); ++i)
+            if (!std::strcmp(zoneNames[i], name))
+                return history[i].stats();
+        return FrameTimeStats();
+    }
+
+    // With the context current: collect the frames still in flight and
+    // release the queries
+    void finish()
+    {
+        if (!active)
+            return;
+        for (unsigned i = 1; i <= framesInFlight; ++i)
+            readResults(frames[(current + i) % framesInFlight], true);
+        for (FrameQueries& f : frames)
+            glDeleteQueries(2 * (maxZones + 1), f.queries);
+        active = false;
+    }
+
+    // `cpuFrame` is the frame pacer's statistics
+    void printStats(std::ostream& out, const FrameTimeStats& cpuFrame) const
+    {
+        if (history.empty() || !history[0].stats().frames)
+            return;
+        char line[256];
+        for (size_t i = 0; i < zoneNames.size(); ++i) {
+            FrameTimeStats s = history[i].stats();
+            std::snprintf(line, sizeof(line), "GPU %-12s mean %.2f ms, p50 %.2f, p95 %.2f, p99 %.2f, max %.2f\n",
+                          zoneNames[i], s.meanMs, s.p50Ms, s.p95Ms, s.p99Ms, s.maxMs);
+            out << line;
+        }
+        // A GPU busy for nearly the whole frame time is what limits the
+        // frame rate; otherwise it is the CPU, or waiting for vsync
+        FrameTimeStats gpu = history[0].stats();
+        if (cpuFrame.p50Ms > 0) {
+            double busy = gpu.p50Ms / cpuFrame.p50Ms;
+            std::snprintf(line, sizeof(line), "GPU busy %.0f%% of the frame time (p50), %s; %zu late frames dropped\n",
+                          busy * 100.0, busy > 0.9 ? "GPU-bound" : "not GPU-bound", late);
+            out << line;
+        }
+    }
+
+private:
+    struct FrameQueries {
+        GLuint queries[2 * (maxZones + 1)]; // begin and end of each record
+        int zoneOf[maxZones + 1];
+        bool ended[maxZones + 1];
+        unsigned count = 0;
+        bool pending = false;
+    };
+
+    bool active = false;
+    FrameQueries frames[framesInFlight];
+    unsigned current = 0;
+    std::vector<const char*> zoneNames; // string literals; 0 is the frame
+    std::vector<FrameTimeHistory> history;
+    double lastMs = 0;
+    size_t late = 0;
+
+    int zoneIndex(const char* name)
+    {
+        for (size_t i = 0; i < zoneNames.size(); ++i)
+            if (zoneNames[i] == name || !std::strcmp(zoneNames[i], name))
+                return (int)i;
+        zoneNames.push_back(name);
+        history.emplace_back();
+        return (int)zoneNames.size() - 1;
+    }
+
+    void readResults(FrameQueries& f, bool wait)
+    {
+        if (!f.pending)
+            return;
+        f.pending = false;
+        if (!f.ended[0])
+            return;
+        if (!wait) {
+            for (unsigned r = 0; r < f.count; ++r) {
+                GLuint available = 0;
+                glGetQueryObjectuiv(f.queries[2 * r + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+                if (f.ended[r] && !available) {
+                    ++late;
+                    return;
+                }
+            }
+        }
+        std::vector<double> zoneMs(zoneNames.size(), -1.0);
+        for (unsigned r = 0; r < f.count; ++r) {
+            if (!f.ended[r])
+                continue;
+            GLuint64 start = 0, stop = 0;
+            glGetQueryObjectui64v(f.queries[2 * r], GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(f.queries[2 * r + 1], GL_QUERY_RESULT, &stop);
+            double& ms = zoneMs[f.zoneOf[r]];
+            ms = (ms < 0 ? 0 : ms) + (stop - start) * 1e-6;
+        }
+        for (size_t i = 0; i < zoneMs.size(); ++i)
+            if (zoneMs[i] >= 0)
+                history[i].record(zoneMs[i]);
+        lastMs = zoneMs[0];
+    }
+};
+
+// Times the enclosing scope as zone `name`
+class GpuZone {
+public:
+    GpuZone(GpuTimer& timer, const char* name) : timer(timer), record(timer.begin(name)) {}
+    ~GpuZone() { timer.end(record); }
+    GpuZone(const GpuZone&) = delete;
+    GpuZone& operator=(const GpuZone&) = delete;
+
+private:
+    GpuTimer& timer;
+    int record;
+};
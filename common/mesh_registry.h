@@ -0,0 +1,154 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <vector>
+#include "gl_state.h"
+#include "vertex_format.h"
+
+// All static meshes of a program in one vertex buffer and one index buffer,
+// shared by zad1 and zad2.
+//
+// Meshes are added on the CPU side first, then build() uploads everything
+// with one glBufferData per buffer. Indices are local to their mesh and the
+// vertex offset is applied with glDrawElementsBaseVertex, so every mesh keeps
+// 16-bit indices and switching between meshes of one format never changes
+// the VAO.
+//
+// Each mesh picks its VertexFormat. Meshes of one format share a VAO whose
+// attributes point at that format's range of the vertex buffer; the VAOs all
+// use the same index buffer. GL 3.3 ties the attribute layout to the VAO, so
+// meshes of different formats cannot share one.
+struct Mesh {
+    int format = 0; // index into the registry's formats
+    GLint baseVertex = 0;
+    GLsizei indexCount = 0;
+    size_t indexOffset = 0; // in bytes, for the draw call
+};
+
+class MeshRegistry {
+public:
+    // Returns the mesh id passed to draw(). The vertices are given as floats,
+    // format.sourceFloats() per vertex, and packed into the format.
+    int add(const VertexFormat& format, const float* vertexData, size_t vertexCount, const uint16_t* indexData,
+            size_t indexCount)
+    {
+        Mesh mesh;
+        mesh.format = formatIndex(format);
+        Pool& pool = pools[mesh.format];
+        mesh.baseVertex = (GLint)(pool.vertices.size() / format.vertexSize());
+        mesh.indexCount = (GLsizei)indexCount;
+        mesh.indexOffset = indices.size() * sizeof(uint16_t);
+        format.pack(vertexData, vertexCount, pool.vertices);
+        indices.insert(indices.end(), indexData, indexData + indexCount);
+        meshes.push_back(mesh);
+        return (int)meshes.size() - 1;
+    }
+
+    // Uploads the meshes added so far; the CPU copies are released
+    void build()
+    {
+        std::vector<unsigned char> vertices;
+        for (Pool& pool : pools) {
+            vertices.resize((vertices.size() + 15) & ~size_t(15));
+            pool.base = vertices.size();
+            vertices.insert(vertices.end(), pool.vertices.begin(), pool.vertices.end());
+            pool.vertices = std::vector<unsigned char>();
+        }
+        glGenBuffers(1, &vbo);
+        glGenBuffers(1, &ebo);
+        glState().bindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size(), vertices.data(), GL_STATIC_DRAW);
+
+        for (Pool& pool : pools) {
+            glGenVertexArrays(1, &pool.vao);
+            glState().bindVertexArray(pool.vao);
+            glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+            if (&pool == &pools.front())
+                glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint16_t), indices.data(),
+                             GL_STATIC_DRAW);
+            pool.format.setupAttributes(pool.base);
+        }
+        indices = std::vector<uint16_t>();
+    }
+
+    void bind(int format = 0) const { glState().bindVertexArray(pools[format].vao); }
+
+    const Mesh& mesh(int id) const { return meshes[id]; }
+
+    // Bytes of vertex data per vertex of a mesh
+    size_t vertexSize(int id) const { return pools[meshes[id].format].format.vertexSize(); }
+
+    void draw(int id, GLenum mode = GL_TRIANGLES) const
+    {
+        const Mesh& m = meshes[id];
+        bind(m.format);
+        glDrawElementsBaseVertex(mode, m.indexCount, GL_UNSIGNED_SHORT, (void*)m.indexOffset, m.baseVertex);
+    }
+
+    // `instances` copies of a mesh; per-instance attributes have to be set up
+    // on the format's VAO by the caller
+    void drawInstanced(int id, GLsizei instances, GLenum mode = GL_TRIANGLES) const
+    {
+        const Mesh& m = meshes[id];
+        bind(m.format);
+        glDrawElementsInstancedBaseVertex(mode, m.indexCount, GL_UNSIGNED_SHORT, (void*)m.indexOffset, instances,
+                                          m.baseVertex);
+    }
+
+    // Several meshes of one vertex format in one call, for draws that share
+    // all uniforms
+    void drawMulti(const int* ids, int count, GLenum mode = GL_TRIANGLES) const
+    {
+        std::vector<GLsizei> counts(count);
+        std::vector<const void*> offsets(count);
+        std::vector<GLint> baseVertices(count);
+        for (int i = 0; i < count; ++i) {
+            const Mesh& m = meshes[ids[i]];
+            counts[i] = m.indexCount;
+            offsets[i] = (const void*)m.indexOffset;
+            baseVertices[i] = m.baseVertex;
+        }
+        bind(count ? meshes[ids[0]].format : 0);
+        glMultiDrawElementsBaseVertex(mode, counts.data(), GL_UNSIGNED_SHORT, offsets.data(), count,
+                                      baseVertices.data());
+    }
+
+    void destroy()
+    {
+        for (Pool& pool : pools) {
+            glState().forgetVertexArray(pool.vao);
+            glDeleteVertexArrays(1, &pool.vao);
+            pool.vao = 0;
+        }
+        glState().forgetBuffer(vbo);
+        glState().forgetBuffer(ebo);
+        glDeleteBuffers(1, &vbo);
+        glDeleteBuffers(1, &ebo);
+        vbo = ebo = 0;
+    }
+
+private:
+    // Vertices of one format and the VAO that reads them
+    struct Pool {
+        explicit Pool(const VertexFormat& format) : format(format) {}
+
+        VertexFormat format;
+        std::vector<unsigned char> vertices;
+        size_t base = 0; // byte offset in the vertex buffer
+        GLuint vao = 0;
+    };
+
+    std::vector<Pool> pools;
+    std::vector<uint16_t> indices;
+    std::vector<Mesh> meshes;
+    GLuint vbo = 0, ebo = 0;
+
+    int formatIndex(const VertexFormat& format)
+    {
+        for (size_t i = 0; i < pools.size(); ++i)
+            if (pools[i].format == format)
+                return (int)i;
+        pools.emplace_back(format);
+        return (int)pools.size() - 1;
+    }
+};
@@ -0,0 +1,184 @@
+#pragma once
+#include <glad/glad.h>
+#include <sys/stat.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "gl_extensions.h"
+
+// On-disk cache of linked shader programs, shared by zad1 and zad2.
+//
+// With ARB_get_program_binary (core in GL 4.1) a linked program can be read
+// back as a driver-specific blob and later handed to glProgramBinary, which
+// skips compiling and linking. Blobs are stored as <dir>/<key>.bin, the key
+// hashing both shader sources together with the GL vendor, renderer and
+// version strings, so an edited shader or a driver update misses the cache
+// instead of loading something stale. The driver may still reject a blob
+// (glProgramBinary leaves the program unlinked); it is then compiled from
+// source again and the file replaced.
+//
+// Without the extension, or with no directory, load() always misses and
+// store() does nothing. Compiling is up to the caller (ShaderManager).
+
+// ARB_get_program_binary, not part of the generated 3.3 loader
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+
+class ProgramCache {
+public:
+    // With the context current; an empty `directory` disables the cache
+    void open(const std::string& directory)
+    {
+        dir = directory;
+        enabled = false;
+        if (dir.empty() || (glContextVersion() < 41 && !hasGLExtension("GL_ARB_get_program_binary")))
+            return;
+        getProgramBinary = (GetProgramBinaryProc)glProc("glGetProgramBinary");
+        programBinary = (ProgramBinaryProc)glProc("glProgramBinary");
+        programParameteri = (ProgramParameteriProc)glProc("glProgramParameteri");
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        if (!getProgramBinary || !programBinary || !programParameteri || formats <= 0)
+            return;
+        mkdir(dir.c_str(), 0755);
+        driver.clear();
+        for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION }) {
+            const char* value = (const char*)glGetString(name);
+            driver += value ? value : "";
+            driver += '\n';
+        }
+        enabled = true;
+    }
+
+    bool available() const { return enabled; }
+
+    // The cached program for the sources, 0 on a miss or a rejected binary
+    GLuint load(const char* vertexSource, const char* fragmentSource)
+    {
+        if (!enabled)
+            return 0;
+        std::ifstream in(path(vertexSource, fragmentSource), std::ios::binary);
+        FileHeader header;
+        if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) || std::memcmp(header.magic, "GLPB", 4) ||
+            header.version != fileVersion || header.sourceHash != sourceHash(vertexSource, fragmentSource))
+            return 0;
+        std::string fileDriver(header.driverLength, '\0');
+        std::vector<char> binary(header.binaryLength);
+        if (!in.read(&fileDriver[0], fileDriver.size()) || fileDriver != driver ||
+            !in.read(binary.data(), binary.size()))
+            return 0;
+
+        GLuint program = glCreateProgram();
+        programBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            ++rejected;
+            glDeleteProgram(program);
+            return 0;
+        }
+        ++hits;
+        return program;
+    }
+
+    // Writes a linked program's binary for later load() calls
+    void store(GLuint program, const char* vertexSource, const char* fragmentSource)
+    {
+        GLint linked = GL_FALSE, length = 0;
+        if (!enabled || !program)
+            return;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (!linked || length <= 0)
+            return;
+        FileHeader header;
+        std::vector<char> binary(length);
+        getProgramBinary(program, length, nullptr, &header.format, binary.data());
+        header.sourceHash = sourceHash(vertexSource, fragmentSource);
+        header.driverLength = (uint32_t)driver.size();
+        header.binaryLength = (uint32_t)length;
+
+        // Written aside and renamed, so a concurrent start never reads half a file
+        std::string target = path(vertexSource, fragmentSource), temporary = target + ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::binary);
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(driver.data(), driver.size());
+            out.write(binary.data(), binary.size());
+            if (!out)
+                return;
+        }
+        if (!std::rename(temporary.c_str(), target.c_str()))
+            ++stored;
+    }
+
+    // Before linking a program that store() will be given
+    void prepare(GLuint program)
+    {
+        if (enabled)
+            programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    void printStats(std::ostream& out) const
+    {
+        if (enabled)
+            out << "Program binary cache: " << hits << " loaded, " << stored << " stored, " << rejected
+                << " rejected\n";
+    }
+
+private:
+    typedef void(APIENTRYP GetProgramBinaryProc)(GLuint, GLsizei, GLsizei*, GLenum*, void*);
+    typedef void(APIENTRYP ProgramBinaryProc)(GLuint, GLenum, const void*, GLsizei);
+    typedef void(APIENTRYP ProgramParameteriProc)(GLuint, GLenum, GLint);
+
+    static const uint32_t fileVersion = 1;
+
+    struct FileHeader {
+        char magic[4] = { 'G', 'L', 'P', 'B' };
+        uint32_t version = fileVersion;
+        GLenum format = 0;
+        uint32_t driverLength = 0; // driver string follows the header
+        uint32_t binaryLength = 0; // then the binary
+        uint64_t sourceHash = 0;
+    };
+
+    std::string dir, driver;
+    bool enabled = false;
+    GetProgramBinaryProc getProgramBinary = nullptr;
+    ProgramBinaryProc programBinary = nullptr;
+    ProgramParameteriProc programParameteri = nullptr;
+    unsigned hits = 0, stored = 0, rejected = 0;
+
+    // FNV-1a
+    static uint64_t hash(const std::string& data, uint64_t h = 14695981039346656037ull)
+    {
+        for (unsigned char c : data)
+            h = (h ^ c) * 1099511628211ull;
+        return h;
+    }
+
+    static uint64_t sourceHash(const char* vertexSource, const char* fragmentSource)
+    {
+        return hash(std::string(fragmentSource) + '\0', hash(std::string(vertexSource) + '\0'));
+    }
+
+    std::string path(const char* vertexSource, const char* fragmentSource) const
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "/%016llx.bin",
+                      (unsigned long long)hash(driver, sourceHash(vertexSource, fragmentSource)));
+        return dir + name;
+    }
+};
+
+// One context, one cache
+inline ProgramCache& programCache()
+{
+    static ProgramCache cache;
+    return cache;
+}
@@ -0,0 +1,177 @@
+#pragma once
+#include <glad/glad.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "gl_extensions.h"
+#include "program_cache.h"
+
+// Shader programs built in the background, shared by zad1 and zad2.
+//
+// submit() starts compiling and linking a program and returns at once: it
+// never asks for a compile or link status, which is what makes a driver
+// finish the work on the spot. With KHR_parallel_shader_compile the driver
+// compiles on its own threads, and poll() checks GL_COMPLETION_STATUS_KHR,
+// which does not block, while the application goes on setting up textures
+// and buffers. Programs whose binary is in the program cache are loaded
+// from it instead and are ready right away.
+//
+// Errors are reported as soon as poll() sees a program finish. program()
+// returns a program for use, waiting for it if it is not done yet; without
+// the extension that is where the compile cost is paid.
+
+// KHR_parallel_shader_compile, not part of the generated 3.3 loader
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+
+class ShaderManager {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // With the context current, before the first submit()
+    void begin()
+    {
+        auto maxThreads = (MaxShaderCompilerThreadsProc)glProc("glMaxShaderCompilerThreadsKHR");
+        if (!maxThreads)
+            maxThreads = (MaxShaderCompilerThreadsProc)glProc("glMaxShaderCompilerThreadsARB");
+        parallel = maxThreads && (hasGLExtension("GL_KHR_parallel_shader_compile") ||
+                                  hasGLExtension("GL_ARB_parallel_shader_compile"));
+        if (parallel)
+            maxThreads(0xFFFFFFFFu); // as many as the driver likes
+    }
+
+    bool parallelCompile() const { return parallel; }
+
+    // Starts building a program; `name` is used in error messages
+    int submit(const char* name, const std::string& vertexSource, const std::string& fragmentSource)
+    {
+        Entry e;
+        e.name = name;
+        e.vertexSource = vertexSource;
+        e.fragmentSource = fragmentSource;
+        e.submitted = Clock::now();
+        e.program = programCache().load(vertexSource.c_str(), fragmentSource.c_str());
+        if (e.program) {
+            e.done = e.cached = true;
+            e.ready = e.submitted;
+        } else {
+            e.shaders[0] = startCompile(GL_VERTEX_SHADER, e.vertexSource);
+            e.shaders[1] = startCompile(GL_FRAGMENT_SHADER, e.fragmentSource);
+            e.program = glCreateProgram();
+            glAttachShader(e.program, e.shaders[0]);
+            glAttachShader(e.program, e.shaders[1]);
+            programCache().prepare(e.program);
+            glLinkProgram(e.program);
+        }
+        entries.push_back(std::move(e));
+        return (int)entries.size() - 1;
+    }
+
+    // Finishes the programs the driver is done with, without waiting;
+    // returns true when none is left. Without parallel compilation nothing
+    // can be checked without waiting, so this only reports.
+    bool poll()
+    {
+        bool all = true;
+        for (Entry& e : entries) {
+            if (e.done)
+                continue;
+            GLint complete = GL_FALSE;
+            if (parallel)
+                glGetProgramiv(e.program, GL_COMPLETION_STATUS_KHR, &complete);
+            if (complete)
+                finish(e);
+            else
+                all = false;
+        }
+        return all;
+    }
+
+    bool ready(int id) const { return entries[id].done; }
+
+    // The linked program, waiting for the driver if needed
+    GLuint program(int id)
+    {
+        Entry& e = entries[id];
+        if (!e.done)
+            finish(e);
+        return e.program;
+    }
+
+    // Programs that failed to compile or link
+    size_t failures() const { return failed; }
+
+    void printStats(std::ostream& out) const
+    {
+        if (entries.empty())
+            return;
+        Clock::time_point first = entries[0].submitted, last = first;
+        unsigned cached = 0;
+        for (const Entry& e : entries) {
+            first = std::min(first, e.submitted);
+            last = std::max(last, e.ready);
+            cached += e.cached;
+        }
+        char line[200];
+        std::snprintf(line, sizeof(line), "Shaders: %zu programs ready %.1f ms after the first submit, %u from binaries, %s\n",
+                      entries.size(), std::chrono::duration<double, std::milli>(last - first).count(), cached,
+                      parallel ? "the rest compiled in parallel" : "the rest compiled on first use");
+        out << line;
+    }
+
+private:
+    typedef void(APIENTRYP MaxShaderCompilerThreadsProc)(GLuint);
+
+    struct Entry {
+        std::string name, vertexSource, fragmentSource;
+        GLuint program = 0, shaders[2] = {};
+        bool done = false, cached = false;
+        Clock::time_point submitted, ready;
+    };
+
+    bool parallel = false;
+    std::vector<Entry> entries;
+    size_t failed = 0;
+
+    static GLuint startCompile(GLenum type, const std::string& source)
+    {
+        GLuint shader = glCreateShader(type);
+        const char* text = source.c_str();
+        glShaderSource(shader, 1, &text, nullptr);
+        glCompileShader(shader);
+        return shader;
+    }
+
+    // Status queries from here on may block, which is fine once the driver
+    // reported completion or the caller needs the program anyway
+    void finish(Entry& e)
+    {
+        GLint linked = GL_FALSE;
+        glGetProgramiv(e.program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            char log[512];
+            for (GLuint shader : e.shaders) {
+                GLint compiled = GL_FALSE;
+                glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+                if (!compiled) {
+                    glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+                    std::cerr << "Shader " << e.name << " compile error: " << log << "\n";
+                }
+            }
+            glGetProgramInfoLog(e.program, sizeof(log), nullptr, log);
+            std::cerr << "Shader " << e.name << " link error: " << log << "\n";
+            ++failed;
+        } else {
+            programCache().store(e.program, e.vertexSource.c_str(), e.fragmentSource.c_str());
+        }
+        for (GLuint& shader : e.shaders) {
+            glDeleteShader(shader);
+            shader = 0;
+        }
+        e.done = true;
+        e.ready = Clock::now();
+    }
+};
@@ -0,0 +1,114 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstring>
+#include <vector>
+#include "gl_state.h"
+
+// std140 uniform blocks, shared by zad1 and zad2.
+//
+// A block is mirrored by a plain C++ struct laid out by std140 rules: vec4
+// and mat4 members as float[4] and float[16], scalars padded so the struct
+// size is a multiple of 16. Each block type is tied to a fixed binding
+// point; programs attach their blocks to it with bindUniformBlock().
+//
+// UniformBlock holds data shared by every draw of a frame and only reaches
+// GL when its contents changed. UniformBlockArray holds one block per object
+// in a single buffer: the objects are filled in on the CPU, written with one
+// glBufferSubData per frame and selected with glBindBufferRange per draw.
+
+// Attach the program's block `name` to `binding`; programs without the
+// block (an old shader from a bundle, say) are left alone
+inline void bindUniformBlock(GLuint program, const char* name, GLuint binding)
+{
+    GLuint index = glGetUniformBlockIndex(program, name);
+    if (index != GL_INVALID_INDEX)
+        glUniformBlockBinding(program, index, binding);
+}
+
+template <typename Block>
+class UniformBlock {
+public:
+    void create(GLuint bindingPoint)
+    {
+        binding = bindingPoint;
+        glGenBuffers(1, &buffer);
+        glState().bindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr, GL_DYNAMIC_DRAW);
+        glState().bindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+        uploaded = false;
+    }
+
+    void update(const Block& data)
+    {
+        if (uploaded && !std::memcmp(&data, &current, sizeof(Block)))
+            return;
+        current = data;
+        uploaded = true;
+        glState().bindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &current);
+    }
+
+    // Other code may have bound something else to the binding point
+    void bind() { glState().bindBufferBase(GL_UNIFORM_BUFFER, binding, buffer); }
+
+    void destroy()
+    {
+        glState().forgetBuffer(buffer);
+        glDeleteBuffers(1, &buffer);
+        buffer = 0;
+    }
+
+private:
+    GLuint buffer = 0, binding = 0;
+    Block current {};
+    bool uploaded = false;
+};
+
+template <typename Block>
+class UniformBlockArray {
+public:
+    void create(GLuint bindingPoint, size_t maxObjects)
+    {
+        binding = bindingPoint;
+        capacity = maxObjects;
+        GLint alignment = 16;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        stride = (sizeof(Block) + alignment - 1) / alignment * alignment;
+        staging.assign(capacity * stride, 0);
+        glGenBuffers(1, &buffer);
+        glState().bindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, staging.size(), nullptr, GL_DYNAMIC_DRAW);
+    }
+
+    size_t size() const { return capacity; }
+
+    // CPU copy of object i, sent by the next upload()
+    Block& operator[](size_t i) { return *reinterpret_cast<Block*>(staging.data() + i * stride); }
+
+    // Writes the first `count` objects. The old storage is orphaned first so
+    // the write never waits for draws of the previous frame.
+    void upload(size_t count)
+    {
+        glState().bindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, staging.size(), nullptr, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, count * stride, staging.data());
+    }
+
+    // Select object i for the following draws
+    void bind(size_t i)
+    {
+        glState().bindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, (GLintptr)(i * stride), sizeof(Block));
+    }
+
+    void destroy()
+    {
+        glState().forgetBuffer(buffer);
+        glDeleteBuffers(1, &buffer);
+        buffer = 0;
+    }
+
+private:
+    GLuint buffer = 0, binding = 0;
+    size_t capacity = 0, stride = 0;
+    std::vector<unsigned char> staging;
+};
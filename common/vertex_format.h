@@ -0,0 +1,137 @@
+#pragma once
+#include <glad/glad.h>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <vector>
+
+// Vertex layout descriptors, shared by zad1 and zad2.
+//
+// A VertexFormat lists the attributes at locations 0, 1, ... with their
+// component count and storage type. Mesh data is always written as floats
+// (one float per component) and pack() converts it to the stored layout;
+// setupAttributes() emits the matching glVertexAttribPointer calls. Every
+// attribute starts on a 4-byte boundary, as drivers prefer.
+//
+// The normalized types map [-1, 1] (Snorm16) or [0, 1] (Unorm16) onto the
+// full 16-bit range, which is enough for clip-space positions and texture
+// coordinates at a fraction of the size of floats.
+enum class VertexType { Float, Half, Snorm16, Unorm16 };
+
+struct VertexAttribute {
+    int components;
+    VertexType type;
+};
+
+inline size_t vertexTypeSize(VertexType type)
+{
+    return type == VertexType::Float ? 4 : 2;
+}
+
+// IEEE 754 binary16, rounding to nearest; tiny values flush to zero
+inline uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, 4);
+    uint16_t sign = (bits >> 16) & 0x8000;
+    int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+    if (((bits >> 23) & 0xff) == 0xff)
+        return sign | 0x7c00 | (mantissa ? 0x200 : 0); // inf, nan
+    if (exponent <= 0)
+        return sign;
+    uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+    half += (mantissa >> 12) & 1; // a carry into the exponent is still correct
+    return half >= 0x7c00 ? sign | 0x7c00 : sign | (uint16_t)half;
+}
+
+class VertexFormat {
+public:
+    VertexFormat(std::initializer_list<VertexAttribute> list) : attributes(list)
+    {
+        for (const VertexAttribute& a : attributes) {
+            offsets.push_back(stride);
+            stride += (a.components * vertexTypeSize(a.type) + 3) & ~size_t(3);
+            floatsPerVertex += a.components;
+        }
+    }
+
+    size_t vertexSize() const { return stride; }
+    int sourceFloats() const { return floatsPerVertex; }
+
+    bool operator==(const VertexFormat& other) const
+    {
+        if (attributes.size() != other.attributes.size())
+            return false;
+        for (size_t i = 0; i < attributes.size(); ++i)
+            if (attributes[i].components != other.attributes[i].components ||
+                attributes[i].type != other.attributes[i].type)
+                return false;
+        return true;
+    }
+
+    // Appends `count` vertices given as sourceFloats() floats each
+    void pack(const float* source, size_t count, std::vector<unsigned char>& out) const
+    {
+        size_t start = out.size();
+        out.resize(start + count * stride, 0);
+        for (size_t v = 0; v < count; ++v) {
+            unsigned char* vertex = out.data() + start + v * stride;
+            for (size_t i = 0; i < attributes.size(); ++i) {
+                for (int c = 0; c < attributes[i].components; ++c)
+                    packComponent(attributes[i].type, *source++, vertex + offsets[i] + c * vertexTypeSize(attributes[i].type));
+            }
+        }
+    }
+
+    // For the bound VAO and GL_ARRAY_BUFFER; `base` is the byte offset of
+    // the first vertex in the buffer
+    void setupAttributes(size_t base) const
+    {
+        for (size_t i = 0; i < attributes.size(); ++i) {
+            const VertexAttribute& a = attributes[i];
+            static const GLenum glTypes[] = { GL_FLOAT, GL_HALF_FLOAT, GL_SHORT, GL_UNSIGNED_SHORT };
+            GLboolean normalized = a.type == VertexType::Snorm16 || a.type == VertexType::Unorm16;
+            glVertexAttribPointer((GLuint)i, a.components, glTypes[(int)a.type], normalized, (GLsizei)stride,
+                                  (void*)(base + offsets[i]));
+            glEnableVertexAttribArray((GLuint)i);
+        }
+    }
+
+private:
+    std::vector<VertexAttribute> attributes;
+    std::vector<size_t> offsets;
+    size_t stride = 0;
+    int floatsPerVertex = 0;
+
+    static void packComponent(VertexType type, float value, unsigned char* dst)
+    {
+        switch (type) {
+        case VertexType::Float:
+            std::memcpy(dst, &value, 4);
+            break;
+        case VertexType::Half: {
+            uint16_t h = floatToHalf(value);
+            std::memcpy(dst, &h, 2);
+            break;
+        }
+        case VertexType::Snorm16: {
+            int16_t s = (int16_t)std::lround(std::fmax(-1.0f, std::fmin(1.0f, value)) * 32767.0f);
+            std::memcpy(dst, &s, 2);
+            break;
+        }
+        case VertexType::Unorm16: {
+            uint16_t u = (uint16_t)std::lround(std::fmax(0.0f, std::fmin(1.0f, value)) * 65535.0f);
+            std::memcpy(dst, &u, 2);
+            break;
+        }
+        }
+    }
+};
+
+// Common layouts: 2D position plus texture coordinates, and 2D position only
+inline const VertexFormat floatPositionUvFormat { { 2, VertexType::Float }, { 2, VertexType::Float } };
+inline const VertexFormat halfPositionUvFormat { { 2, VertexType::Half }, { 2, VertexType::Unorm16 } };
+inline const VertexFormat compactPositionUvFormat { { 2, VertexType::Snorm16 }, { 2, VertexType::Unorm16 } };
+inline const VertexFormat compactPositionFormat { { 2, VertexType::Snorm16 } };
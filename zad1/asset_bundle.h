@@ -0,0 +1,151 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Single-file asset bundle, written offline by pack_assets.cpp and mapped
+// read-only at runtime.
+//
+//   BundleHeader
+//   payloads, each starting on a bundleAlignment boundary
+//   BundleEntry[entryCount] at indexOffset
+//
+// Texture payloads are RGBA8 with the full mip chain, level 0 first, rows
+// bottom-up as OpenGL expects them. Rows of 4-byte pixels need no unpack
+// alignment changes, so every level is passed to glTexImage2D straight from
+// the mapped pages. Shader payloads are the GLSL source text.
+
+const char bundleMagic[4] = { 'G', 'K', 'A', 'B' };
+const uint32_t bundleVersion = 1;
+const uint64_t bundleAlignment = 4096; // page size, payloads map on their own pages
+
+enum BundleEntryType : uint32_t { BUNDLE_TEXTURE = 1, BUNDLE_SHADER = 2 };
+enum BundleFormat : uint32_t { BUNDLE_RGBA8 = 1 };
+
+struct BundleHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t reserved;
+    uint64_t indexOffset;
+};
+
+struct BundleEntry {
+    char name[56];
+    uint32_t type;   // BundleEntryType
+    uint32_t format; // BundleFormat, textures only
+    uint64_t offset;
+    uint64_t size;
+    uint32_t width, height, levels; // textures only
+    uint32_t reserved;
+};
+
+static_assert(sizeof(BundleHeader) == 24, "bundle header layout");
+static_assert(sizeof(BundleEntry) == 96, "bundle entry layout");
+
+// Byte size of mip level `level` of a texture entry
+inline uint64_t bundleLevelSize(const BundleEntry& entry, uint32_t level)
+{
+    uint64_t w = entry.width >> level, h = entry.height >> level;
+    return (w ? w : 1) * (h ? h : 1) * 4;
+}
+
+inline uint64_t bundleTextureSize(const BundleEntry& entry)
+{
+    uint64_t total = 0;
+    for (uint32_t level = 0; level < entry.levels; ++level)
+        total += bundleLevelSize(entry, level);
+    return total;
+}
+
+class AssetBundle {
+public:
+    ~AssetBundle() { close(); }
+
+    bool open(const char* path)
+    {
+        close();
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "Failed to open bundle " << path << "\n";
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(BundleHeader)) {
+            mappedSize = (size_t)st.st_size;
+            void* p = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+            base = p == MAP_FAILED ? nullptr : (const unsigned char*)p;
+        }
+        ::close(fd); // the mapping keeps the file alive
+        if (!base || !validate()) {
+            std::cerr << "Invalid bundle " << path << "\n";
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+        if (base)
+            munmap((void*)base, mappedSize);
+        base = nullptr;
+        mappedSize = 0;
+    }
+
+    bool isOpen() const { return base != nullptr; }
+
+    const BundleEntry* find(const char* name, BundleEntryType type) const
+    {
+        if (!base)
+            return nullptr;
+        for (uint32_t i = 0; i < header().entryCount; ++i) {
+            const BundleEntry& entry = entries()[i];
+            if (entry.type == type && !std::strncmp(entry.name, name, sizeof(entry.name)))
+                return &entry;
+        }
+        return nullptr;
+    }
+
+    const unsigned char* data(const BundleEntry& entry) const { return base + entry.offset; }
+
+    // Shader source, or an empty string if the bundle has no such shader
+    std::string shaderSource(const char* name) const
+    {
+        const BundleEntry* entry = find(name, BUNDLE_SHADER);
+        return entry ? std::string((const char*)data(*entry), entry->size) : std::string();
+    }
+
+private:
+    const unsigned char* base = nullptr;
+    size_t mappedSize = 0;
+
+    const BundleHeader& header() const { return *(const BundleHeader*)base; }
+    const BundleEntry* entries() const { return (const BundleEntry*)(base + header().indexOffset); }
+
+    // Everything the reader dereferences has to lie inside the mapping
+    bool validate() const
+    {
+        const BundleHeader& h = header();
+        if (std::memcmp(h.magic, bundleMagic, 4) || h.version != bundleVersion)
+            return false;
+        if (h.indexOffset % alignof(BundleEntry) || h.indexOffset > mappedSize ||
+            h.entryCount > (mappedSize - h.indexOffset) / sizeof(BundleEntry))
+            return false;
+        for (uint32_t i = 0; i < h.entryCount; ++i) {
+            const BundleEntry& entry = entries()[i];
+            if (entry.offset > mappedSize || entry.size > mappedSize - entry.offset)
+                return false;
+            if (entry.type == BUNDLE_TEXTURE &&
+                (entry.format != BUNDLE_RGBA8 || !entry.width || !entry.height || !entry.levels || entry.levels > 32 ||
+                 bundleTextureSize(entry) > entry.size))
+                return false;
+        }
+        return true;
+    }
+};
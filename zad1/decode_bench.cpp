@@ -0,0 +1,349 @@
+// Decode benchmark for stb_image.h.
+//
+// Runs stbi_load_from_memory over a corpus of image files and/or generated
+// images for every requested req_comp and reports input MB/s, output
+// megapixels/s, allocations and decoder high-water mark per decode (through
+// stbi_instrument.h). Use --json to write the results in a form that can be diffed between changes, and --context to
+// decode through a reusable stbi_decoder_context.
+//
+//   ./decode_bench [--synthetic] [--req-comp 0,3,4] [--iterations N]
+//                  [--context] [--json out.json] [files or directories...]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+#include "stbi_instrument.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+struct CorpusImage {
+    std::string name;
+    std::string format;
+    std::vector<unsigned char> bytes;
+};
+
+struct Result {
+    std::string name, format;
+    int width = 0, height = 0, reqComp = 0;
+    size_t inputBytes = 0;
+    double seconds = 0;  // best of all iterations
+    double mbPerSec = 0, mpixPerSec = 0;
+    StbiDecodeStats stats; // from the fastest iteration
+    bool ok = false;
+};
+
+// Format name from the file header; JPEG and PNG are split further because
+// their decode paths differ (progressive JPEG, 16-bit PNG)
+static std::string detectFormat(const std::vector<unsigned char>& b)
+{
+    if (b.size() > 4 && b[0] == 0xFF && b[1] == 0xD8) {
+        for (size_t i = 2; i + 1 < b.size(); ++i) {
+            if (b[i] != 0xFF)
+                continue;
+            if (b[i + 1] == 0xC2)
+                return "jpeg-progressive";
+            if (b[i + 1] == 0xC0 || b[i + 1] == 0xC1)
+                return "jpeg-baseline";
+        }
+        return "jpeg";
+    }
+    if (b.size() > 24 && !memcmp(b.data(), "\x89PNG", 4))
+        return b[24] == 16 ? "png-16" : "png-8";
+    if (b.size() > 3 && !memcmp(b.data(), "GIF", 3))
+        return "gif";
+    if (b.size() > 2 && b[0] == 'B' && b[1] == 'M')
+        return "bmp";
+    if (b.size() > 2 && b[0] == '#' && b[1] == '?')
+        return "hdr";
+    if (b.size() > 2 && b[0] == 'P' && (b[1] == '5' || b[1] == '6'))
+        return "pnm";
+    if (b.size() > 4 && !memcmp(b.data(), "8BPS", 4))
+        return "psd";
+    return "tga"; // TGA has no magic number
+}
+
+// --- Synthetic corpus -----------------------------------------------------
+// Simple writers for the formats that can be produced without a real
+// encoder. JPEG and GIF have to come from files on disk.
+
+static void put16le(std::vector<unsigned char>& v, uint32_t x) { v.push_back(x & 255); v.push_back((x >> 8) & 255); }
+static void put32le(std::vector<unsigned char>& v, uint32_t x) { put16le(v, x & 0xFFFF); put16le(v, x >> 16); }
+static void put32be(std::vector<unsigned char>& v, uint32_t x)
+{
+    for (int s = 24; s >= 0; s -= 8)
+        v.push_back((x >> s) & 255);
+}
+
+static unsigned char pattern(int x, int y, int c)
+{
+    return (unsigned char)((x * (c + 1) + y * (3 - c) + ((x ^ y) & 31)) & 255);
+}
+
+static std::vector<unsigned char> makeBmp(int w, int h)
+{
+    int stride = (w * 3 + 3) & ~3;
+    std::vector<unsigned char> v;
+    v.push_back('B'); v.push_back('M');
+    put32le(v, 54 + stride * h); put32le(v, 0); put32le(v, 54);
+    put32le(v, 40); put32le(v, w); put32le(v, h); put16le(v, 1); put16le(v, 24);
+    put32le(v, 0); put32le(v, stride * h); put32le(v, 2835); put32le(v, 2835); put32le(v, 0); put32le(v, 0);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x)
+            for (int c = 2; c >= 0; --c)
+                v.push_back(pattern(x, y, c));
+        v.resize(v.size() + stride - w * 3);
+    }
+    return v;
+}
+
+static std::vector<unsigned char> makeTga(int w, int h)
+{
+    std::vector<unsigned char> v = { 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+    put16le(v, w); put16le(v, h); v.push_back(32); v.push_back(8);
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x) {
+            v.push_back(pattern(x, y, 2)); v.push_back(pattern(x, y, 1));
+            v.push_back(pattern(x, y, 0)); v.push_back(255);
+        }
+    return v;
+}
+
+static std::vector<unsigned char> makeHdr(int w, int h)
+{
+    std::string head = "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y " + std::to_string(h) + " +X " + std::to_string(w) + "\n";
+    std::vector<unsigned char> v(head.begin(), head.end());
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x) {
+            v.push_back(pattern(x, y, 0) | 128); v.push_back(pattern(x, y, 1) | 128);
+            v.push_back(pattern(x, y, 2) | 128); v.push_back(128);
+        }
+    return v;
+}
+
+static uint32_t crc32(const unsigned char* p, size_t n, uint32_t crc = 0)
+{
+    crc = ~crc;
+    while (n--) {
+        crc ^= *p++;
+        for (int k = 0; k < 8; ++k)
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+    }
+    return ~crc;
+}
+
+static void pngChunk(std::vector<unsigned char>& v, const char* type, const std::vector<unsigned char>& data)
+{
+    put32be(v, (uint32_t)data.size());
+    size_t start = v.size();
+    v.insert(v.end(), type, type + 4);
+    v.insert(v.end(), data.begin(), data.end());
+    put32be(v, crc32(&v[start], v.size() - start));
+}
+
+// PNG with "stored" deflate blocks and Paeth-free rows: exercises the zlib
+// and defiltering paths without needing a compressor
+static std::vector<unsigned char> makePng(int w, int h, int depth)
+{
+    int bytesPerSample = depth / 8;
+    std::vector<unsigned char> raw;
+    for (int y = 0; y < h; ++y) {
+        raw.push_back(y % 2); // alternate filter None / Sub
+        for (int x = 0; x < w; ++x)
+            for (int c = 0; c < 3; ++c)
+                for (int b = 0; b < bytesPerSample; ++b)
+                    raw.push_back(pattern(x, y, c));
+    }
+    std::vector<unsigned char> z = { 0x78, 0x01 };
+    for (size_t pos = 0; pos < raw.size(); pos += 65535) {
+        size_t len = std::min<size_t>(65535, raw.size() - pos);
+        z.push_back(pos + len == raw.size());
+        put16le(z, (uint32_t)len); put16le(z, (uint32_t)~len & 0xFFFF);
+        z.insert(z.end(), raw.begin() + pos, raw.begin() + pos + len);
+    }
+    uint32_t a = 1, b = 0;
+    for (unsigned char c : raw) { a = (a + c) % 65521; b = (b + a) % 65521; }
+    put32be(z, (b << 16) | a);
+
+    std::vector<unsigned char> v = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    std::vector<unsigned char> ihdr;
+    put32be(ihdr, w); put32be(ihdr, h);
+    ihdr.push_back(depth); ihdr.push_back(2); ihdr.push_back(0); ihdr.push_back(0); ihdr.push_back(0);
+    pngChunk(v, "IHDR", ihdr);
+    pngChunk(v, "IDAT", z);
+    pngChunk(v, "IEND", {});
+    return v;
+}
+
+static void addSynthetic(std::vector<CorpusImage>& corpus)
+{
+    for (int size : { 256, 1024, 2048 }) {
+        std::string dim = std::to_string(size) + "x" + std::to_string(size);
+        corpus.push_back({ "synthetic-" + dim + ".bmp", "bmp", makeBmp(size, size) });
+        corpus.push_back({ "synthetic-" + dim + ".tga", "tga", makeTga(size, size) });
+        corpus.push_back({ "synthetic-" + dim + ".hdr", "hdr", makeHdr(size, size) });
+        corpus.push_back({ "synthetic-" + dim + "-8.png", "png-8", makePng(size, size, 8) });
+        corpus.push_back({ "synthetic-" + dim + "-16.png", "png-16", makePng(size, size, 16) });
+    }
+}
+
+static void addPath(std::vector<CorpusImage>& corpus, const std::string& path)
+{
+    struct stat st {};
+    if (stat(path.c_str(), &st) != 0) {
+        std::cerr << "Skipping " << path << ": not found\n";
+        return;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        DIR* dir = opendir(path.c_str());
+        std::vector<std::string> names;
+        while (dirent* entry = readdir(dir))
+            if (entry->d_name[0] != '.')
+                names.push_back(entry->d_name);
+        closedir(dir);
+        std::sort(names.begin(), names.end());
+        for (const std::string& name : names)
+            addPath(corpus, path + "/" + name);
+        return;
+    }
+    std::ifstream file(path, std::ios::binary);
+    std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    int w, h, n;
+    if (!stbi_info_from_memory(bytes.data(), (int)bytes.size(), &w, &h, &n))
+        return; // not an image
+    corpus.push_back({ path, detectFormat(bytes), std::move(bytes) });
+}
+
+static Result run(const CorpusImage& img, int reqComp, int iterations)
+{
+    Result r;
+    r.name = img.name;
+    r.format = img.format;
+    r.reqComp = reqComp;
+    r.inputBytes = img.bytes.size();
+    r.seconds = 1e30;
+    for (int i = 0; i < iterations; ++i) {
+        int n;
+        auto start = std::chrono::steady_clock::now();
+        void* pixels = img.format == "hdr"
+            ? (void*)stbi_loadf_from_memory(img.bytes.data(), (int)img.bytes.size(), &r.width, &r.height, &n, reqComp)
+            : (void*)stbi_load_from_memory(img.bytes.data(), (int)img.bytes.size(), &r.width, &r.height, &n, reqComp);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        stbi_image_free(pixels);
+        if (!pixels)
+            return r;
+        if (seconds < r.seconds) {
+            r.seconds = seconds;
+            r.stats = stbiLastDecodeStats();
+        }
+    }
+    r.ok = true;
+    r.mbPerSec = r.inputBytes / 1e6 / r.seconds;
+    r.mpixPerSec = (double)r.width * r.height / 1e6 / r.seconds;
+    return r;
+}
+
+static std::string jsonEscape(const std::string& s)
+{
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+static void writeJson(const std::string& path, const std::vector<Result>& results, bool context)
+{
+    std::ofstream out(path);
+    out << "{\n  \"stb_image\": \"2.30\",\n  \"decoder_context\": " << (context ? "true" : "false")
+        << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        out << "    {\"name\": \"" << jsonEscape(r.name) << "\", \"format\": \"" << r.format
+            << "\", \"width\": " << r.width << ", \"height\": " << r.height
+            << ", \"req_comp\": " << r.reqComp << ", \"input_bytes\": " << r.inputBytes
+            << ", \"ok\": " << (r.ok ? "true" : "false")
+            << ", \"seconds\": " << r.seconds << ", \"mb_per_s\": " << r.mbPerSec
+            << ", \"mpix_per_s\": " << r.mpixPerSec << ", \"allocs\": " << r.stats.allocCount
+            << ", \"alloc_bytes\": " << r.stats.allocBytes << ", \"peak_alloc_bytes\": " << r.stats.peakBytes
+            << ", \"phase_ms\": {";
+        for (int p = 0; p < STBI_PHASE_COUNT; ++p)
+            out << (p ? ", " : "") << "\"" << stbiPhaseName(p) << "\": " << r.stats.phaseSeconds[p] * 1e3;
+        out << "}}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<CorpusImage> corpus;
+    std::vector<int> reqComps = { 0, 3, 4 };
+    int iterations = 5;
+    bool synthetic = false, context = false;
+    std::string jsonPath;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--synthetic")) {
+            synthetic = true;
+        } else if (!strcmp(argv[i], "--context")) {
+            context = true;
+        } else if (!strcmp(argv[i], "--iterations") && i + 1 < argc) {
+            iterations = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--json") && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else if (!strcmp(argv[i], "--req-comp") && i + 1 < argc) {
+            reqComps.clear();
+            for (const char* p = argv[++i]; *p; ++p)
+                if (*p >= '0' && *p <= '4')
+                    reqComps.push_back(*p - '0');
+        } else {
+            addPath(corpus, argv[i]);
+        }
+    }
+    if (synthetic)
+        addSynthetic(corpus);
+    if (corpus.empty()) {
+        std::cerr << "usage: " << argv[0] << " [--synthetic] [--req-comp 0,3,4] [--iterations N]"
+                  << " [--context] [--json out.json] [files or directories...]\n";
+        return 1;
+    }
+    stbi_decoder_context* decoderContext = context ? stbi_decoder_context_create() : nullptr;
+    stbi_set_decoder_context_thread(decoderContext);
+
+    std::vector<Result> results;
+    stbiSetDumpAtExit(false);
+    printf("%-40s %-17s %11s %3s %9s %9s %7s %10s %10s\n",
+           "image", "format", "size", "req", "MB/s", "MP/s", "allocs", "alloc KB", "peak KB");
+    for (const CorpusImage& img : corpus) {
+        for (int reqComp : reqComps) {
+            Result r = run(img, reqComp, iterations);
+            results.push_back(r);
+            std::string name = r.name.size() > 40 ? "..." + r.name.substr(r.name.size() - 37) : r.name;
+            if (!r.ok) {
+                printf("%-40s %-17s failed: %s\n", name.c_str(), r.format.c_str(), stbi_failure_reason());
+                continue;
+            }
+            std::string size = std::to_string(r.width) + "x" + std::to_string(r.height);
+            printf("%-40s %-17s %11s %3d %9.1f %9.1f %7zu %10zu %10zu\n",
+                   name.c_str(), r.format.c_str(), size.c_str(), r.reqComp, r.mbPerSec, r.mpixPerSec,
+                   r.stats.allocCount, r.stats.allocBytes / 1024, r.stats.peakBytes / 1024);
+        }
+    }
+    if (!jsonPath.empty())
+        writeJson(jsonPath, results, context);
+    stbi_set_decoder_context_thread(nullptr);
+    stbi_decoder_context_free(decoderContext);
+    return 0;
+}
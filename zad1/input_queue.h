@@ -0,0 +1,124 @@
+#pragma once
+#include <GLFW/glfw3.h>
+#include <atomic>
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+// Input events recorded by the GLFW callbacks and applied once per frame.
+//
+// The callbacks only push timestamped events into a single-producer,
+// single-consumer ring; nothing in them touches GL or application state.
+// At the start of a frame collect() drains the ring and coalesces the
+// events: scroll deltas are summed and presses are counted per key, so a
+// trackpad delivering dozens of ticks or a key bouncing within one frame
+// costs a single state update.
+
+struct InputEvent {
+    enum Type { Key, Scroll };
+    Type type;
+    int key, action; // Key
+    double dx, dy;   // Scroll
+    double time;     // glfwGetTime() when the callback ran
+};
+
+// Coalesced input of one frame
+struct FrameInput {
+    struct KeyCount {
+        int key;
+        int presses; // GLFW_PRESS events
+        int repeats; // GLFW_REPEAT events
+    };
+
+    double scrollX = 0.0, scrollY = 0.0;
+    std::vector<KeyCount> keys; // in the order of their first event
+    double lastKeyTime = -1.0;  // time of the last press, -1 if none
+    size_t events = 0;
+
+    bool empty() const { return events == 0; }
+
+    int presses(int key) const
+    {
+        for (const KeyCount& k : keys)
+            if (k.key == key)
+                return k.presses;
+        return 0;
+    }
+
+    // Presses plus auto-repeats, for keys that act while held
+    int strokes(int key) const
+    {
+        for (const KeyCount& k : keys)
+            if (k.key == key)
+                return k.presses + k.repeats;
+        return 0;
+    }
+};
+
+class InputQueue {
+public:
+    static const size_t capacity = 256; // power of two
+
+    // Producer side, called from the GLFW callbacks. When the ring is full
+    // the event is dropped and counted.
+    void pushKey(int key, int action, double time) { push({ InputEvent::Key, key, action, 0.0, 0.0, time }); }
+    void pushScroll(double dx, double dy, double time) { push({ InputEvent::Scroll, 0, 0, dx, dy, time }); }
+
+    // Consumer side, once per frame
+    FrameInput collect()
+    {
+        FrameInput input;
+        size_t tail = readIndex.load(std::memory_order_relaxed);
+        size_t head = writeIndex.load(std::memory_order_acquire);
+        for (; tail != head; ++tail) {
+            const InputEvent& e = ring[tail & (capacity - 1)];
+            ++input.events;
+            if (e.type == InputEvent::Scroll) {
+                input.scrollX += e.dx;
+                input.scrollY += e.dy;
+                continue;
+            }
+            FrameInput::KeyCount* count = nullptr;
+            for (FrameInput::KeyCount& k : input.keys)
+                if (k.key == e.key)
+                    count = &k;
+            if (!count) {
+                input.keys.push_back({ e.key, 0, 0 });
+                count = &input.keys.back();
+            }
+            if (e.action == GLFW_PRESS) {
+                ++count->presses;
+                input.lastKeyTime = e.time;
+            } else if (e.action == GLFW_REPEAT) {
+                ++count->repeats;
+            }
+        }
+        readIndex.store(tail, std::memory_order_release);
+        return input;
+    }
+
+    size_t droppedEvents() const { return dropped.load(std::memory_order_relaxed); }
+
+    // At exit; silent unless the ring ever overflowed
+    void printStats(std::ostream& out) const
+    {
+        if (size_t n = droppedEvents())
+            out << "Input queue: " << n << " events dropped, more than " << capacity << " arrived within a frame\n";
+    }
+
+private:
+    InputEvent ring[capacity];
+    std::atomic<size_t> writeIndex { 0 }, readIndex { 0 };
+    std::atomic<size_t> dropped { 0 };
+
+    void push(const InputEvent& e)
+    {
+        size_t head = writeIndex.load(std::memory_order_relaxed);
+        if (head - readIndex.load(std::memory_order_acquire) == capacity) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        ring[head & (capacity - 1)] = e;
+        writeIndex.store(head + 1, std::memory_order_release);
+    }
+};
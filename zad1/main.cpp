@@ -1,232 +1,629 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../common/app_window.h"
+#include "../common/cpu_profiler.h"
+#include "../common/dynamic_resolution.h"
+#include "../common/frame_capture.h"
+#include "../common/frame_pacer.h"
+#include "../common/gl_state.h"
+#include "../common/gpu_timer.h"
+#include "../common/mesh_registry.h"
+#include "../common/program_cache.h"
+#include "../common/shader_manager.h"
+#include "../common/uniform_buffer.h"
+#include "asset_bundle.h"
+#include "input_queue.h"
+#include "shaders.h"
+#include "sprite_scene.h"
+#include "texture_loader.h"
+#include "texture_residency.h"
+#include "texture_watcher.h"
+#include "virtual_texture.h"
+#ifdef STBI_INSTRUMENT
+#include "stbi_instrument.h" // build with -DSTBI_INSTRUMENT for decode stats at exit
+#endif
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
-// Vertex shader source
-const char* vertexShaderSource = R"(#version 330 core
-layout(location = 0) in vec3 aPos;
-layout(location = 1) in vec2 aTexCoords;
-out vec2 TexCoords;
-void main()
-{
-    gl_Position = vec4(aPos, 1.0);
-    TexCoords = aTexCoords;
-})";
-
-// Fragment shader source
-const char* fragmentShaderSource = R"(#version 330 core
-out vec4 FragColor;
-in vec2 TexCoords;
-uniform sampler2D uTexture;
-uniform vec4 uColor;
-uniform float uMixFactor;
-void main()
-{
-    vec4 texColor = texture(uTexture, TexCoords);
-    FragColor = mix(texColor, uColor, uMixFactor);
-}
-)";
+// Window dimensions, overridable with --size <width>x<height>
+unsigned int SCR_WIDTH = 800;
+unsigned int SCR_HEIGHT = 600;
 
-// Window dimensions
-const unsigned int SCR_WIDTH = 800;
-const unsigned int SCR_HEIGHT = 600;
+// A GLFW window, or an offscreen framebuffer with --headless <frames>
+AppWindow appWindow;
 
 // Globals for mixing
 float mixFactor = 0.0f;
-int mixLoc, colorLoc, texLoc;
 unsigned int shaderProgram;
 
-// Scroll callback: adjust mix factor
+// Uniform blocks: mixFactor once per frame, color and mix per shape
+UniformBlock<FrameUniforms> frameUniforms;
+UniformBlockArray<ShapeUniforms> shapeUniforms;
+
+// With --on-demand the loop sleeps in glfwWaitEvents and only redraws when
+// something visible changed: input, a texture finishing or a window refresh
+bool onDemand = false;
+bool needsRedraw = true;
+
+// Set with --virtual-texture <image>: shows one huge image instead of the shapes
+VirtualTexture* virtualTexture = nullptr;
+
+// Set with --scene <file>: instanced sprites from a scene file instead of the shapes
+SpriteScene* spriteScene = nullptr;
+
+// Filled by the callbacks, applied by applyInput() once per frame
+InputQueue inputQueue;
+
+// Scroll callback: queue the delta, applyInput adjusts the mix factor
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
-    mixFactor += static_cast<float>(yoffset) * 0.05f;
-    mixFactor = std::clamp(mixFactor, 0.0f, 1.0f);
-    glUseProgram(shaderProgram);
-    glUniform1f(mixLoc, mixFactor);
+    inputQueue.pushScroll(xoffset, yoffset, glfwGetTime());
 }
 
 bool showSquare   = false;
 bool showTriangle = false;
 
+// Textures are decoded lazily the first time their shape is shown
+// (place texture1.jpg and texture2.jpg in working dir)
+LazyTexture squareTexture   { "texture1.jpg" };
+LazyTexture triangleTexture { "texture2.jpg" };
+
+// GPU texture memory budget, overridable with --texture-budget <MB>
+TextureResidency residency(256u << 20);
+
+// Reloads texture files when they change on disk
+TextureWatcher textureWatcher;
+
+// Drawn instead of the texture while it is still decoding
+const float placeholderColor[4] = { 0.5f, 0.5f, 0.5f, 1.0f };
+
+// Seconds without input after which hidden textures are prefetched
+const double prefetchIdleSeconds = 1.0;
+double lastInputTime = 0.0;
+
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
+    if (action != GLFW_RELEASE)
+        inputQueue.pushKey(key, action, glfwGetTime());
+}
+
+// Apply the input queued since the last frame. Scroll ticks are summed and
+// a toggle key pressed an even number of times within one frame cancels out.
+void applyInput()
+{
+    FrameInput input = inputQueue.collect();
+    if (input.empty())
+        return;
+    if (virtualTexture) {
+        // strzałki przesuwają widok, także przy przytrzymaniu
+        virtualTexture->zoom(static_cast<float>(input.scrollY));
+        float dx = 0.1f * (input.strokes(GLFW_KEY_RIGHT) - input.strokes(GLFW_KEY_LEFT));
+        float dy = 0.1f * (input.strokes(GLFW_KEY_UP) - input.strokes(GLFW_KEY_DOWN));
+        if (dx || dy)
+            virtualTexture->pan(dx, dy);
+        return;
+    }
+    needsRedraw = true;
+    mixFactor += static_cast<float>(input.scrollY) * 0.05f;
+    mixFactor = std::clamp(mixFactor, 0.0f, 1.0f);
+
     // reagujemy tylko na pojedyncze naciśnięcie
-    if (action == GLFW_PRESS) {
-        if (key == GLFW_KEY_Q) {
+    if (input.lastKeyTime < 0)
+        return;
+    lastInputTime = input.lastKeyTime;
+    for (const FrameInput::KeyCount& k : input.keys) {
+        if (k.presses % 2 == 0)
+            continue;
+        if (k.key == GLFW_KEY_Q) {
             showSquare = !showSquare; // toggle kwadratu
         }
-        else if (key == GLFW_KEY_T) {
+        else if (k.key == GLFW_KEY_T) {
             showTriangle = !showTriangle; // toggle trójkąta
         }
-        else if (key == GLFW_KEY_B) {
+        else if (k.key == GLFW_KEY_B) {
             // 2 na raz
             bool both = showSquare && showTriangle;
             showSquare = showTriangle = !both;
         }
     }
+    if (showSquare)   requestTexture(squareTexture);
+    if (showTriangle) requestTexture(triangleTexture);
+}
+
+// Set with --keys: key presses replayed at given frames, for headless runs
+std::vector<std::pair<long, int>> scriptedKeys;
+bool untilSettled = false;
+
+void pushScriptedKeys()
+{
+    for (size_t i = 0; i < scriptedKeys.size();) {
+        if (scriptedKeys[i].first <= appWindow.frameCount()) {
+            inputQueue.pushKey(scriptedKeys[i].second, GLFW_PRESS, appWindow.time());
+            scriptedKeys.erase(scriptedKeys.begin() + i);
+        } else {
+            ++i;
+        }
+    }
 }
 
-int main()
+void refresh_callback(GLFWwindow* window)
 {
-    // Initialize GLFW
-    if (!glfwInit()) {
-        std::cerr << "Failed to initialize GLFW\n";
-        return -1;
+    needsRedraw = true;
+}
+
+// A hidden texture that was never loaded can be decoded in the background
+bool prefetchWanted()
+{
+    return squareTexture.state != TextureState::Loading &&
+           triangleTexture.state != TextureState::Loading &&
+           residency.residentBytes() < residency.budgetBytes &&
+           ((squareTexture.state == TextureState::Unloaded && squareTexture.gpuBytes == 0) ||
+            (triangleTexture.state == TextureState::Unloaded && triangleTexture.gpuBytes == 0));
+}
+
+// Set with --gl-stats: print the state cache counts about once a second
+bool printGlStats = false;
+double lastGlStatsTime = 0.0;
+
+// Swap interval or frame cap, set with --pacing; frame times are printed at exit
+FramePacer pacer;
+
+// Set with --capture <dir>: every rendered frame is written out as a PPM
+const char* captureDir = nullptr;
+FrameCapture frameCapture;
+
+// Set with --trace <file>: Chrome trace of the CPU zones, in builds with
+// -DCPU_PROFILER
+const char* tracePath = nullptr;
+
+// Linked shader programs are kept here between runs; --shader-cache <dir>
+// moves it, --shader-cache off compiles every time
+std::string shaderCacheDir = ".shader_cache";
+
+// Set with --gpu-timing: GPU time of each frame and shape, printed at exit
+bool gpuTiming = false;
+GpuTimer gpuTimer;
+
+// Set with --dynamic-res <ms>: frames are drawn at a lower resolution and
+// upscaled while they take longer than the budget
+double resolutionBudgetMs = 0;
+DynamicResolution resolution;
+
+// The window's framebuffer changed size (resize, or a screen of another scale)
+void framebufferResized(int width, int height)
+{
+    SCR_WIDTH = width;
+    SCR_HEIGHT = height;
+    glViewport(0, 0, width, height);
+    resolution.resize(width, height);
+    frameCapture.resize(width, height);
+    if (virtualTexture)
+        virtualTexture->resize(width, height);
+    needsRedraw = true;
+}
+
+// After every swap
+void endFrameStats()
+{
+    PROFILE_FRAME();
+    resolution.endFrame(gpuTimer.enabled() ? gpuTimer.lastFrameMs() : 0.0);
+    pacer.endFrame();
+    glState().endFrame();
+    double now = appWindow.time();
+    if (!printGlStats || now - lastGlStatsTime < 1.0)
+        return;
+    lastGlStatsTime = now;
+    const GLStateCache::Counts& counts = glState().lastFrameCounts();
+    std::cout << "GL state calls per frame: " << counts.issued << " issued, " << counts.skipped << " skipped";
+    if (gpuTimer.enabled())
+        std::cout << ", GPU " << gpuTimer.lastFrameMs() << " ms";
+    std::cout << "\n";
+}
+
+// End of a rendered frame: hand it to the capture, swap and keep the stats
+void presentFrame()
+{
+    {
+        PROFILE_ZONE("upscale");
+        resolution.end();
+    }
+    {
+        PROFILE_ZONE("capture");
+        frameCapture.capture(appWindow.frameCount());
+    }
+    {
+        PROFILE_ZONE("swap");
+        appWindow.swapBuffers();
     }
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    endFrameStats();
+}
+
+// Both shapes live in one buffer: 2D position and texture coordinates,
+// stored as set with --vertex-format float|half|compact
+MeshRegistry meshes;
+const VertexFormat* shapeFormat = &compactPositionUvFormat;
+int squareMesh, triangleMesh;
+
+// The texture mixed with white by the frame's mixFactor, or the placeholder
+// color until the texture is ready
+void setShapeUniforms(ShapeUniforms& shape, const LazyTexture& tex)
+{
+    bool ready = tex.state == TextureState::Ready;
+    for (int i = 0; i < 4; ++i)
+        shape.color[i] = ready ? 1.0f : placeholderColor[i];
+    shape.minMix = ready ? 0.0f : 1.0f;
+}
 
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Shapes with Textures", nullptr, nullptr);
-    if (!window) {
-        std::cerr << "Failed to create GLFW window\n";
-        glfwTerminate();
+// Draw a shape with its texture and its slot in shapeUniforms; the sprites
+// drawn before it leave their own program bound
+void drawTextured(LazyTexture& tex, int mesh, int slot)
+{
+    residency.markVisible(tex);
+    glState().useProgram(shaderProgram);
+    if (tex.state == TextureState::Ready) {
+        glState().activeTexture(GL_TEXTURE0);
+        glState().bindTexture(GL_TEXTURE_2D, tex.id);
+    }
+    shapeUniforms.bind(slot);
+    meshes.draw(mesh);
+}
+
+int main(int argc, char** argv)
+{
+    PROFILE_THREAD("main");
+
+    // Command line options
+    EvictPolicy evictPolicy = EvictPolicy::Redecode;
+    const char* virtualTexturePath = nullptr;
+    const char* bundlePath = nullptr;
+    const char* scenePath = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--texture-budget") && i + 1 < argc) {
+            const char* arg = argv[++i];
+            char* end;
+            unsigned long mb = std::strtoul(arg, &end, 10);
+            if (end == arg || *end || std::strchr(arg, '-')) {
+                std::cerr << "Invalid --texture-budget " << arg << ", expected megabytes\n";
+                return 1;
+            }
+            residency.budgetBytes = (size_t)mb << 20;
+        } else if (!std::strcmp(argv[i], "--evict-policy") && i + 1 < argc) {
+            std::string policy = argv[++i];
+            if (policy == "encoded")      evictPolicy = EvictPolicy::KeepEncoded;
+            else if (policy == "decoded") evictPolicy = EvictPolicy::KeepDecoded;
+            else                          evictPolicy = EvictPolicy::Redecode;
+        } else if (!std::strcmp(argv[i], "--virtual-texture") && i + 1 < argc) {
+            virtualTexturePath = argv[++i];
+        } else if (!std::strcmp(argv[i], "--scene") && i + 1 < argc) {
+            scenePath = argv[++i];
+        } else if (!std::strcmp(argv[i], "--bundle") && i + 1 < argc) {
+            bundlePath = argv[++i];
+        } else if (!std::strcmp(argv[i], "--texture-format") && i + 1 < argc) {
+            padTextureChannels = std::strcmp(argv[++i], "native") != 0;
+        } else if (!std::strcmp(argv[i], "--on-demand")) {
+            onDemand = true;
+        } else if (!std::strcmp(argv[i], "--vertex-format") && i + 1 < argc) {
+            const char* format = argv[++i];
+            if (!std::strcmp(format, "float"))
+                shapeFormat = &floatPositionUvFormat;
+            else if (!std::strcmp(format, "half"))
+                shapeFormat = &halfPositionUvFormat;
+            else
+                shapeFormat = &compactPositionUvFormat;
+        } else if (!std::strcmp(argv[i], "--pacing") && i + 1 < argc) {
+            if (!pacer.parse(argv[++i]))
+                std::cerr << "Unknown pacing mode " << argv[i] << ", using vsync\n";
+        } else if (!std::strcmp(argv[i], "--gl-stats")) {
+            printGlStats = true;
+        } else if (!std::strcmp(argv[i], "--shader-cache") && i + 1 < argc) {
+            shaderCacheDir = argv[++i];
+            if (shaderCacheDir == "off")
+                shaderCacheDir.clear();
+        } else if (!std::strcmp(argv[i], "--trace") && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if (!std::strcmp(argv[i], "--dynamic-res") && i + 1 < argc) {
+            resolutionBudgetMs = std::atof(argv[++i]);
+        } else if (!std::strcmp(argv[i], "--gpu-timing")) {
+            gpuTiming = true;
+        } else if (!std::strcmp(argv[i], "--capture") && i + 1 < argc) {
+            captureDir = argv[++i];
+        } else if (!std::strcmp(argv[i], "--headless") && i + 1 < argc) {
+            appWindow.setHeadless(std::atol(argv[++i]));
+        } else if (!std::strcmp(argv[i], "--size") && i + 1 < argc) {
+            std::sscanf(argv[++i], "%ux%u", &SCR_WIDTH, &SCR_HEIGHT);
+        } else if (!std::strcmp(argv[i], "--keys") && i + 1 < argc) {
+            // <frame>:<key>,... e.g. 0:B,30:Q
+            for (const char* p = argv[++i]; *p;) {
+                long frame;
+                char key;
+                if (std::sscanf(p, "%ld:%c", &frame, &key) == 2)
+                    scriptedKeys.push_back({ frame, std::toupper(key) });
+                p = std::strchr(p, ',');
+                if (!p)
+                    break;
+                ++p;
+            }
+        } else if (!std::strcmp(argv[i], "--until-settled")) {
+            untilSettled = true;
+        }
+    }
+    if (appWindow.isHeadless())
+        onDemand = false; // no events to wait for
+
+    // Assets found in the bundle replace the loose files and built-in shaders
+    AssetBundle bundle;
+    if (bundlePath && !bundle.open(bundlePath))
         return -1;
+    SpriteScene scene;
+    if (scenePath) {
+        if (!scene.load(scenePath))
+            return -1;
+        spriteScene = &scene;
+    }
+    std::vector<LazyTexture*> textures = { &squareTexture, &triangleTexture };
+    for (SceneTexture& t : scene.textures())
+        textures.push_back(&t.texture);
+    for (LazyTexture* tex : textures) {
+        if (const BundleEntry* entry = bundle.find(tex->path, BUNDLE_TEXTURE)) {
+            tex->bundled = entry;
+            tex->bundleData = bundle.data(*entry);
+        }
+        tex->policy = evictPolicy;
+        residency.track(*tex);
+        textureWatcher.track(*tex);
     }
-    glfwMakeContextCurrent(window);
+    std::string bundledVertex = bundle.shaderSource("shape.vert");
+    std::string bundledFragment = bundle.shaderSource("shape.frag");
+    const char* vertexSource = bundledVertex.empty() ? vertexShaderSource : bundledVertex.c_str();
+    const char* fragmentSource = bundledFragment.empty() ? fragmentShaderSource : bundledFragment.c_str();
 
-    // Load OpenGL functions with GLAD
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-        std::cerr << "Failed to initialize GLAD\n";
+    // Create the window (or headless context) and load OpenGL functions
+    if (!appWindow.open(SCR_WIDTH, SCR_HEIGHT, "Shapes with Textures")) {
+        appWindow.close();
         return -1;
     }
+    pacer.begin(!appWindow.isHeadless());
+    // On high-DPI screens the framebuffer has more pixels than the window
+    SCR_WIDTH = appWindow.framebufferWidth();
+    SCR_HEIGHT = appWindow.framebufferHeight();
+    appWindow.onResize = framebufferResized;
+    if (captureDir)
+        frameCapture.start(captureDir, appWindow.framebufferWidth(), appWindow.framebufferHeight());
+    if (gpuTiming)
+        gpuTimer.create();
+
+    // Start building the shader program; the driver compiles it while the
+    // geometry and the virtual texture are set up. A binary cached by an
+    // earlier run with the same sources and driver is loaded instead.
+    ShaderManager shaders;
+    shaders.begin();
+    programCache().open(shaderCacheDir);
+    int shapeShader = shaders.submit("shape", vertexSource, fragmentSource);
+    resolution.create(SCR_WIDTH, SCR_HEIGHT, resolutionBudgetMs, shaders);
 
     glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
-    glfwSetScrollCallback(window, scroll_callback);
-    glfwSetKeyCallback   (window, key_callback);
-
-    // Build and compile shaders
-    unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, nullptr);
-    glCompileShader(vertexShader);
-    // Check compile errors...
-    unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, nullptr);
-    glCompileShader(fragmentShader);
-
-    shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    if (GLFWwindow* window = appWindow.glfw()) {
+        glfwSetScrollCallback(window, scroll_callback);
+        glfwSetKeyCallback   (window, key_callback);
+        glfwSetWindowRefreshCallback(window, refresh_callback);
+
+        // Decoder and hot reload threads wake the loop when a texture is ready
+        onTextureDecoded = glfwPostEmptyEvent;
+    }
+
+    // Headless runs can stop once the scripted keys are in and every shown
+    // texture has finished loading
+    if (untilSettled) {
+        appWindow.headlessDone = [] {
+            return scriptedKeys.empty() && squareTexture.state != TextureState::Loading &&
+                   triangleTexture.state != TextureState::Loading && !(spriteScene && spriteScene->loading()) &&
+                   !needsRedraw;
+        };
+    }
 
     // Geometry: square (left) and triangle (right)
     float squareVertices[] = {
-        // pos             // tex
-        -0.9f,  0.75f, 0.0f,  0.0f, 1.0f,
-        -0.9f, -0.75f, 0.0f,  0.0f, 0.0f,
-        -0.1f, -0.75f, 0.0f,  1.0f, 0.0f,
-        -0.9f,  0.75f, 0.0f,  0.0f, 1.0f,
-        -0.1f, -0.75f, 0.0f,  1.0f, 0.0f,
-        -0.1f,  0.75f, 0.0f,  1.0f, 1.0f
+        // pos          // tex
+        -0.9f,  0.75f,  0.0f, 1.0f,
+        -0.9f, -0.75f,  0.0f, 0.0f,
+        -0.1f, -0.75f,  1.0f, 0.0f,
+        -0.1f,  0.75f,  1.0f, 1.0f
     };
+    uint16_t squareIndices[] = { 0, 1, 2, 0, 2, 3 };
     float triangleVertices[] = {
-        // pos             // tex
-         0.1f, -0.75f, 0.0f,  0.0f, 0.0f,
-         0.9f, -0.75f, 0.0f,  1.0f, 0.0f,
-         0.5f,  0.75f, 0.0f,  0.5f, 1.0f
+        // pos          // tex
+         0.1f, -0.75f,  0.0f, 0.0f,
+         0.9f, -0.75f,  1.0f, 0.0f,
+         0.5f,  0.75f,  0.5f, 1.0f
     };
+    uint16_t triangleIndices[] = { 0, 1, 2 };
 
-    unsigned int VAO1, VBO1, VAO2, VBO2;
-    // Square setup
-    glGenVertexArrays(1, &VAO1);
-    glGenBuffers(1, &VBO1);
-    glBindVertexArray(VAO1);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO1);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(squareVertices), squareVertices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-
-    // Triangle setup
-    glGenVertexArrays(1, &VAO2);
-    glGenBuffers(1, &VBO2);
-    glBindVertexArray(VAO2);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO2);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(triangleVertices), triangleVertices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-
-    // Load textures (place texture1.jpg and texture2.jpg in working dir)
+    squareMesh = meshes.add(*shapeFormat, squareVertices, 4, squareIndices, 6);
+    triangleMesh = meshes.add(*shapeFormat, triangleVertices, 3, triangleIndices, 3);
+    if (spriteScene)
+        spriteScene->addMeshes(meshes, *shapeFormat);
+    meshes.build();
+    shaders.poll(); // reports compile errors as soon as they are known
+
+    // Textures are loaded on demand (see key_callback) and flipped while they
+    // are uploaded; the global flip only applies to the tile cache builder
     stbi_set_flip_vertically_on_load(true);
-    unsigned int texture1, texture2;
-    glGenTextures(1, &texture1);
-    glBindTexture(GL_TEXTURE_2D, texture1);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    int width, height, nrChannels;
-    unsigned char* data = stbi_load("texture1.jpg", &width, &height, &nrChannels, 0);
-    if (data) {
-        GLenum format = (nrChannels == 3) ? GL_RGB : GL_RGBA;
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    } else std::cerr << "Failed to load texture1.jpg\n";
-    stbi_image_free(data);
-
-    glGenTextures(1, &texture2);
-    glBindTexture(GL_TEXTURE_2D, texture2);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    data = stbi_load("texture2.jpg", &width, &height, &nrChannels, 0);
-    if (data) {
-        GLenum format = (nrChannels == 3) ? GL_RGB : GL_RGBA;
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    } else std::cerr << "Failed to load texture2.jpg\n";
-    stbi_image_free(data);
+    textureWatcher.start();
+
+    VirtualTexture vt;
+    if (virtualTexturePath) {
+        if (!vt.init(virtualTexturePath, SCR_WIDTH, SCR_HEIGHT, shaders)) {
+            appWindow.close();
+            return -1;
+        }
+        virtualTexture = &vt;
+    }
+    if (spriteScene) {
+        spriteScene->build(shaders);
+        std::cout << "Scene " << scenePath << ": " << spriteScene->spriteCount() << " sprites, "
+                  << spriteScene->textures().size() << " textures, " << spriteScene->drawCount()
+                  << " instanced draws per frame\n";
+    }
 
     // Configure shader uniforms
-    glUseProgram(shaderProgram);
-    texLoc   = glGetUniformLocation(shaderProgram, "uTexture");
-    colorLoc = glGetUniformLocation(shaderProgram, "uColor");
-    mixLoc   = glGetUniformLocation(shaderProgram, "uMixFactor");
-    glUniform1i(texLoc, 0);
-    glUniform4f(colorLoc, 1.0f, 1.0f, 1.0f, 1.0f);
-    glUniform1f(mixLoc, mixFactor);
+    {
+        PROFILE_ZONE("wait for shaders");
+        shaderProgram = shaders.program(shapeShader);
+    }
+    // Shape shaders bundled before the uniform blocks read plain uniforms
+    // that nothing sets any more and would draw everything black
+    if ((!bundledVertex.empty() || !bundledFragment.empty()) &&
+        (glGetUniformBlockIndex(shaderProgram, "Frame") == GL_INVALID_INDEX ||
+         glGetUniformBlockIndex(shaderProgram, "Shape") == GL_INVALID_INDEX)) {
+        std::cerr << "Bundled shape shaders lack the Frame and Shape uniform blocks, using the built-in ones\n";
+        glDeleteProgram(shaderProgram);
+        shaderProgram = shaders.program(shaders.submit("shape", vertexShaderSource, fragmentShaderSource));
+    }
+    glState().useProgram(shaderProgram);
+    glUniform1i(glGetUniformLocation(shaderProgram, "uTexture"), 0);
+    bindUniformBlock(shaderProgram, "Frame", frameUniformBinding);
+    bindUniformBlock(shaderProgram, "Shape", shapeUniformBinding);
+    frameUniforms.create(frameUniformBinding);
+    shapeUniforms.create(shapeUniformBinding, 2);
 
     // Render loop
-    while (!glfwWindowShouldClose(window)) {
-        
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-
-        glUseProgram(shaderProgram);
-        if (showSquare) {
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, texture1);
-            glBindVertexArray(VAO1);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
+    while (!appWindow.shouldClose()) {
+        {
+            PROFILE_ZONE("input");
+            pushScriptedKeys();
+            applyInput();
+        }
+
+        // The virtual texture streams tiles from its feedback pass, so it
+        // always renders continuously
+        if (virtualTexture) {
+            resolution.begin();
+            gpuTimer.beginFrame();
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            {
+                PROFILE_ZONE("vt update");
+                GpuZone zone(gpuTimer, "vt update");
+                virtualTexture->update();
+            }
+            {
+                PROFILE_ZONE("vt render");
+                GpuZone zone(gpuTimer, "vt render");
+                virtualTexture->render(resolution.renderWidth(), resolution.renderHeight());
+            }
+            gpuTimer.endFrame();
+            presentFrame();
+            PROFILE_ZONE("events");
+            appWindow.pollEvents();
+            continue;
+        }
+
+        // Upload textures whose decode finished since the last frame, then
+        // swap in the ones edited on disk. Loads land before reloads, so a
+        // reload that waited for an in-flight load is applied on the same wakeup
+        {
+            PROFILE_ZONE("textures");
+            if (pollTexture(squareTexture))
+                needsRedraw = true;
+            if (pollTexture(triangleTexture))
+                needsRedraw = true;
+            if (spriteScene && spriteScene->poll())
+                needsRedraw = true;
+            if (textureWatcher.applyReloads())
+                needsRedraw = true;
         }
-        if (showTriangle) {
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, texture2);
-            glBindVertexArray(VAO2);
-            glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        // Predictive prefetch: use idle time to decode still-hidden textures
+        // that were never loaded, as long as the budget has room left
+        double idle = appWindow.time() - lastInputTime;
+        if (idle > prefetchIdleSeconds && prefetchWanted()) {
+            if (squareTexture.state == TextureState::Unloaded && squareTexture.gpuBytes == 0)
+                requestTexture(squareTexture);
+            else
+                requestTexture(triangleTexture);
         }
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        if (needsRedraw || !onDemand) {
+            needsRedraw = false;
+            resolution.begin();
+            gpuTimer.beginFrame();
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            glState().useProgram(shaderProgram);
+            {
+                PROFILE_ZONE("uniforms");
+                FrameUniforms frame {};
+                frame.mixFactor = mixFactor;
+                frameUniforms.update(frame);
+                setShapeUniforms(shapeUniforms[0], squareTexture);
+                setShapeUniforms(shapeUniforms[1], triangleTexture);
+                shapeUniforms.upload(2);
+            }
+            {
+                PROFILE_ZONE("draw");
+                if (spriteScene) {
+                    GpuZone zone(gpuTimer, "sprites");
+                    spriteScene->draw(residency, placeholderColor);
+                }
+                if (showSquare) {
+                    GpuZone zone(gpuTimer, "square");
+                    drawTextured(squareTexture, squareMesh, 0);
+                }
+                if (showTriangle) {
+                    GpuZone zone(gpuTimer, "triangle");
+                    drawTextured(triangleTexture, triangleMesh, 1);
+                }
+            }
+            gpuTimer.endFrame();
+            residency.endFrame();
+            presentFrame();
+        }
+
+        PROFILE_ZONE("events");
+        if (!onDemand) {
+            appWindow.pollEvents();
+            continue;
+        }
+        if (prefetchWanted())
+            appWindow.waitEventsTimeout(std::max(prefetchIdleSeconds - idle, 0.01));
+        else
+            appWindow.waitEvents();
+        pacer.restartFrame();
     }
 
     // Cleanup
-    glDeleteVertexArrays(1, &VAO1);
-    glDeleteBuffers(1, &VBO1);
-    glDeleteVertexArrays(1, &VAO2);
-    glDeleteBuffers(1, &VBO2);
+    textureWatcher.stop();
+    if (virtualTexture)
+        virtualTexture->destroy();
+    if (spriteScene)
+        spriteScene->destroy();
+    destroyTexture(squareTexture);
+    destroyTexture(triangleTexture);
+    meshes.destroy();
+    resolution.destroy();
+    frameUniforms.destroy();
+    shapeUniforms.destroy();
     glDeleteProgram(shaderProgram);
-    glfwDestroyWindow(window);
-    glfwTerminate();
+    frameCapture.finish();
+    gpuTimer.finish();
+    appWindow.close();
+    pacer.printStats(std::cout);
+    inputQueue.printStats(std::cout);
+    gpuTimer.printStats(std::cout, pacer.stats());
+    resolution.printStats(std::cout);
+    shaders.printStats(std::cout);
+    programCache().printStats(std::cout);
+    cpuProfilerReport(tracePath, std::cout);
+    frameCapture.printStats(std::cout);
 
     return 0;
 }
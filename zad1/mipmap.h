@@ -0,0 +1,39 @@
+#pragma once
+#include <algorithm>
+#include <vector>
+
+// CPU mip generation for RGBA8 images, shared by the tile cache builder and
+// the asset packer
+
+// 2x2 box filter, edges clamped
+inline std::vector<unsigned char> downsample(const unsigned char* px, int w, int h, int& outW, int& outH)
+{
+    outW = std::max(1, w / 2);
+    outH = std::max(1, h / 2);
+    std::vector<unsigned char> out((size_t)outW * outH * 4);
+    for (int y = 0; y < outH; ++y) {
+        int y0 = std::min(2 * y, h - 1), y1 = std::min(2 * y + 1, h - 1);
+        for (int x = 0; x < outW; ++x) {
+            int x0 = std::min(2 * x, w - 1), x1 = std::min(2 * x + 1, w - 1);
+            for (int c = 0; c < 4; ++c) {
+                int sum = px[((size_t)y0 * w + x0) * 4 + c] + px[((size_t)y0 * w + x1) * 4 + c]
+                        + px[((size_t)y1 * w + x0) * 4 + c] + px[((size_t)y1 * w + x1) * 4 + c];
+                out[((size_t)y * outW + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+    return out;
+}
+
+// Levels 1..n of a full mip chain down to 1x1; level 0 is the source itself
+inline std::vector<std::vector<unsigned char>> buildMipChain(const unsigned char* px, int w, int h)
+{
+    std::vector<std::vector<unsigned char>> levels;
+    while (w > 1 || h > 1) {
+        int nw, nh;
+        levels.push_back(downsample(levels.empty() ? px : levels.back().data(), w, h, nw, nh));
+        w = nw;
+        h = nh;
+    }
+    return levels;
+}
@@ -0,0 +1,166 @@
+// Offline packer for asset bundles (see asset_bundle.h).
+//
+// Images are decoded here once, converted to RGBA8, flipped to OpenGL's
+// bottom-up row order and stored with their full mip chain, so the app only
+// maps the bundle and uploads. Other files (.vert, .frag, .glsl) are stored
+// as shader sources. The built-in shaders from shaders.h are always added
+// as shape.vert and shape.frag unless a file with that name is given.
+//
+//   ./pack_assets out.bundle texture1.jpg texture2.jpg [shaders...]
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "asset_bundle.h"
+#include "mipmap.h"
+#include "shaders.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+struct PackedAsset {
+    BundleEntry entry {};
+    std::vector<unsigned char> payload;
+};
+
+static std::string baseName(const std::string& path)
+{
+    size_t slash = path.rfind('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+static bool setName(BundleEntry& entry, const std::string& name)
+{
+    if (name.size() >= sizeof(entry.name)) {
+        std::cerr << "Asset name too long: " << name << "\n";
+        return false;
+    }
+    std::memcpy(entry.name, name.c_str(), name.size() + 1);
+    return true;
+}
+
+static bool packTexture(const std::string& path, PackedAsset& asset)
+{
+    int w, h, n;
+    stbi_set_flip_vertically_on_load(true);
+    unsigned char* px = stbi_load(path.c_str(), &w, &h, &n, 4);
+    if (!px) {
+        std::cerr << "Failed to decode " << path << ": " << stbi_failure_reason() << "\n";
+        return false;
+    }
+    std::vector<std::vector<unsigned char>> mips = buildMipChain(px, w, h);
+    asset.entry.type = BUNDLE_TEXTURE;
+    asset.entry.format = BUNDLE_RGBA8;
+    asset.entry.width = w;
+    asset.entry.height = h;
+    asset.entry.levels = 1 + (uint32_t)mips.size();
+    asset.payload.assign(px, px + (size_t)w * h * 4);
+    for (const std::vector<unsigned char>& level : mips)
+        asset.payload.insert(asset.payload.end(), level.begin(), level.end());
+    stbi_image_free(px);
+    return true;
+}
+
+static void packShader(const std::string& source, PackedAsset& asset)
+{
+    asset.entry.type = BUNDLE_SHADER;
+    asset.payload.assign(source.begin(), source.end());
+}
+
+static bool isShaderFile(const std::string& path)
+{
+    for (const char* ext : { ".vert", ".frag", ".glsl" }) {
+        size_t len = std::strlen(ext);
+        if (path.size() > len && path.compare(path.size() - len, len, ext) == 0)
+            return true;
+    }
+    return false;
+}
+
+static void pad(std::ofstream& out, uint64_t& offset, uint64_t alignment)
+{
+    static const char zeros[bundleAlignment] = {};
+    uint64_t padding = (alignment - offset % alignment) % alignment;
+    out.write(zeros, padding);
+    offset += padding;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " out.bundle [images and shaders...]\n";
+        return 1;
+    }
+
+    std::vector<PackedAsset> assets;
+    bool hasVert = false, hasFrag = false;
+    for (int i = 2; i < argc; ++i) {
+        std::string path = argv[i], name = baseName(path);
+        PackedAsset asset;
+        if (!setName(asset.entry, name))
+            return 1;
+        if (isShaderFile(path)) {
+            std::ifstream file(path, std::ios::binary);
+            if (!file) {
+                std::cerr << "Failed to read " << path << "\n";
+                return 1;
+            }
+            packShader(std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()), asset);
+            hasVert |= name == "shape.vert";
+            hasFrag |= name == "shape.frag";
+        } else if (!packTexture(path, asset)) {
+            return 1;
+        }
+        assets.push_back(std::move(asset));
+    }
+    if (!hasVert) {
+        assets.emplace_back();
+        setName(assets.back().entry, "shape.vert");
+        packShader(vertexShaderSource, assets.back());
+    }
+    if (!hasFrag) {
+        assets.emplace_back();
+        setName(assets.back().entry, "shape.frag");
+        packShader(fragmentShaderSource, assets.back());
+    }
+
+    std::ofstream out(argv[1], std::ios::binary);
+    BundleHeader header {};
+    std::memcpy(header.magic, bundleMagic, 4);
+    header.version = bundleVersion;
+    header.entryCount = (uint32_t)assets.size();
+    out.write((const char*)&header, sizeof(header));
+    uint64_t offset = sizeof(header);
+
+    for (PackedAsset& asset : assets) {
+        pad(out, offset, bundleAlignment);
+        asset.entry.offset = offset;
+        asset.entry.size = asset.payload.size();
+        out.write((const char*)asset.payload.data(), asset.payload.size());
+        offset += asset.payload.size();
+    }
+    pad(out, offset, alignof(BundleEntry));
+    header.indexOffset = offset;
+    for (const PackedAsset& asset : assets)
+        out.write((const char*)&asset.entry, sizeof(asset.entry));
+
+    out.seekp(0);
+    out.write((const char*)&header, sizeof(header));
+    if (!out) {
+        std::cerr << "Failed to write " << argv[1] << "\n";
+        return 1;
+    }
+
+    for (const PackedAsset& asset : assets) {
+        std::cout << asset.entry.name << ": ";
+        if (asset.entry.type == BUNDLE_TEXTURE)
+            std::cout << asset.entry.width << "x" << asset.entry.height << " RGBA8, " << asset.entry.levels
+                      << " levels, ";
+        std::cout << asset.entry.size << " bytes at " << asset.entry.offset << "\n";
+    }
+    return 0;
+}
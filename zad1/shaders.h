@@ -0,0 +1,87 @@
+#pragma once
+
+// Built-in shader sources. The asset packer stores the shape shaders in
+// bundles as shape.vert and shape.frag; a bundle passed with --bundle
+// overrides them. The sprite shaders of --scene are always built in.
+
+// std140 mirrors of the uniform blocks below and their binding points
+struct FrameUniforms {
+    float mixFactor;
+    float pad[3];
+};
+
+struct ShapeUniforms {
+    float color[4];
+    float minMix; // 1 draws the flat color, 0 follows the frame's mixFactor
+    float pad[3];
+};
+
+static_assert(sizeof(FrameUniforms) == 16 && sizeof(ShapeUniforms) == 32, "std140 layout");
+
+const unsigned frameUniformBinding = 0;
+const unsigned shapeUniformBinding = 1;
+
+// Vertex shader source
+inline const char* vertexShaderSource = R"(#version 330 core
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec2 aTexCoords;
+out vec2 TexCoords;
+void main()
+{
+    gl_Position = vec4(aPos, 1.0);
+    TexCoords = aTexCoords;
+})";
+
+// Fragment shader source
+inline const char* fragmentShaderSource = R"(#version 330 core
+out vec4 FragColor;
+in vec2 TexCoords;
+uniform sampler2D uTexture;
+layout(std140) uniform Frame {
+    float uMixFactor;
+};
+layout(std140) uniform Shape {
+    vec4 uColor;
+    float uMinMix;
+};
+void main()
+{
+    vec4 texColor = texture(uTexture, TexCoords);
+    FragColor = mix(texColor, uColor, max(uMixFactor, uMinMix));
+}
+)";
+
+// Sprites of a scene file: one unit quad or triangle per instance, moved and
+// scaled by the instance attribute, mixed with uColor by the larger of the
+// frame's, the texture's and the sprite's own mix factor
+inline const char* spriteVertexShaderSource = R"(#version 330 core
+layout(location = 0) in vec2 aPos;
+layout(location = 1) in vec2 aTexCoords;
+layout(location = 2) in vec4 aSprite; // x, y, scale, mix
+out vec2 TexCoords;
+out float SpriteMix;
+void main()
+{
+    gl_Position = vec4(aSprite.xy + aPos * aSprite.z, 0.0, 1.0);
+    TexCoords = aTexCoords;
+    SpriteMix = aSprite.w;
+})";
+
+inline const char* spriteFragmentShaderSource = R"(#version 330 core
+out vec4 FragColor;
+in vec2 TexCoords;
+in float SpriteMix;
+uniform sampler2D uTexture;
+layout(std140) uniform Frame {
+    float uMixFactor;
+};
+layout(std140) uniform Shape {
+    vec4 uColor;
+    float uMinMix;
+};
+void main()
+{
+    vec4 texColor = texture(uTexture, TexCoords);
+    FragColor = mix(texColor, uColor, max(max(uMixFactor, uMinMix), SpriteMix));
+}
+)";
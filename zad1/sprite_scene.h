@@ -0,0 +1,275 @@
+#pragma once
+#include <glad/glad.h>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../common/cpu_profiler.h"
+#include "../common/gl_state.h"
+#include "../common/mesh_registry.h"
+#include "../common/shader_manager.h"
+#include "../common/uniform_buffer.h"
+#include "shaders.h"
+#include "texture_loader.h"
+#include "texture_residency.h"
+
+// A scene of textured sprites read from a text file, drawn instanced.
+//
+//   # comment
+//   texture <name> <image>                        relative to the scene file
+//   quad <x> <y> <scale> <texture> <mix>
+//   triangle <x> <y> <scale> <texture> <mix>
+//   scatter <count> quad|triangle <texture> <minScale> <maxScale> <mix>
+//
+// Positions are in clip space and scale is the half size of the sprite;
+// mix blends the texture towards white like the scroll wheel does. scatter
+// places `count` sprites at random (but the same on every run), so one line
+// is enough for a stress test with a million of them.
+//
+// Every sprite is one instance of a unit quad or triangle. The two shapes
+// are added to the app's mesh registry, so they share its buffers and the
+// VAO of their vertex format, which also gets the instance attribute. The
+// instances are sorted by texture and shape into one buffer, so a frame
+// costs one glDrawElementsInstancedBaseVertex per texture and shape whatever
+// the number of sprites. GL 3.3 has no base instance, so the instance
+// attribute is pointed at each group's first instance before its draw.
+struct SpriteInstance {
+    float x, y, scale, mix;
+};
+
+struct SceneTexture {
+    std::string name, path;
+    LazyTexture texture { nullptr };
+};
+
+class SpriteScene {
+public:
+    bool load(const std::string& file)
+    {
+        std::ifstream in(file);
+        if (!in) {
+            std::cerr << "Failed to open scene " << file << "\n";
+            return false;
+        }
+        size_t slash = file.rfind('/');
+        std::string dir = slash == std::string::npos ? "" : file.substr(0, slash + 1);
+        std::string line, kind;
+        for (int lineNumber = 1; std::getline(in, line); ++lineNumber) {
+            std::istringstream words(line);
+            if (!(words >> kind) || kind[0] == '#')
+                continue;
+            bool ok = false;
+            if (kind == "texture") {
+                std::string name, path;
+                if ((ok = bool(words >> name >> path)))
+                    addTexture(name, path[0] == '/' ? path : dir + path);
+            } else if (kind == "quad" || kind == "triangle") {
+                Sprite s;
+                std::string texture;
+                s.shape = kind == "quad" ? 0 : 1;
+                ok = words >> s.instance.x >> s.instance.y >> s.instance.scale >> texture >> s.instance.mix &&
+                     (s.texture = findTexture(texture)) >= 0;
+                if (ok)
+                    sprites.push_back(s);
+            } else if (kind == "scatter") {
+                long count;
+                std::string shape, texture;
+                float minScale, maxScale, mix;
+                int textureIndex = -1;
+                ok = words >> count >> shape >> texture >> minScale >> maxScale >> mix && count > 0 &&
+                     minScale <= maxScale && (shape == "quad" || shape == "triangle") &&
+                     (textureIndex = findTexture(texture)) >= 0;
+                if (ok)
+                    scatter(count, shape == "quad" ? 0 : 1, textureIndex, minScale, maxScale, mix, lineNumber);
+            }
+            if (!ok) {
+                std::cerr << file << ":" << lineNumber << ": cannot read \"" << line << "\"\n";
+                return false;
+            }
+        }
+        if (sprites.empty()) {
+            std::cerr << "Scene " << file << " has no sprites\n";
+            return false;
+        }
+        return true;
+    }
+
+    // Stable addresses, so the residency manager and the watcher can track them
+    std::deque<SceneTexture>& textures() { return sceneTextures; }
+
+    size_t spriteCount() const { return instanceCount ? instanceCount : sprites.size(); }
+    size_t drawCount() const { return groups.size(); }
+
+    // Before `registry` is built
+    void addMeshes(MeshRegistry& registry, const VertexFormat& format)
+    {
+        // Unit shapes, texture coordinates flipped like the textures are
+        float quad[] = { -1, 1, 0, 1, -1, -1, 0, 0, 1, -1, 1, 0, 1, 1, 1, 1 };
+        uint16_t quadIndices[] = { 0, 1, 2, 0, 2, 3 };
+        float triangle[] = { -1, -1, 0, 0, 1, -1, 1, 0, 0, 1, 0.5f, 1 };
+        uint16_t triangleIndices[] = { 0, 1, 2 };
+        meshes = &registry;
+        shapeMeshes[0] = registry.add(format, quad, 4, quadIndices, 6);
+        shapeMeshes[1] = registry.add(format, triangle, 3, triangleIndices, 3);
+    }
+
+    // Once the registry is built; the sprites are released on the CPU side
+    void build(ShaderManager& shaders)
+    {
+        PROFILE_ZONE("build scene");
+        int spriteShader = shaders.submit("sprite", spriteVertexShaderSource, spriteFragmentShaderSource);
+
+        // Counting sort by texture and shape; each non-empty bucket is a draw
+        size_t keys = sceneTextures.size() * 2;
+        std::vector<size_t> start(keys + 1, 0);
+        for (const Sprite& s : sprites)
+            ++start[key(s) + 1];
+        for (size_t k = 0; k < keys; ++k) {
+            if (start[k + 1])
+                groups.push_back({ (int)(k / 2), shapeMeshes[k % 2], (GLint)start[k], (GLsizei)start[k + 1] });
+            start[k + 1] += start[k];
+        }
+        std::vector<SpriteInstance> instances(sprites.size());
+        for (const Sprite& s : sprites)
+            instances[start[key(s)]++] = s.instance;
+        instanceCount = sprites.size();
+        sprites = std::vector<Sprite>();
+
+        glGenBuffers(1, &instanceBuffer);
+        glState().bindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(SpriteInstance), instances.data(), GL_STATIC_DRAW);
+        // The app's own shapes draw with this VAO too, so the attribute
+        // points into the buffer from the start
+        meshes->bind(meshes->mesh(shapeMeshes[0]).format);
+        glVertexAttribPointer(instanceAttribute, 4, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance), (void*)0);
+        glEnableVertexAttribArray(instanceAttribute);
+        glVertexAttribDivisor(instanceAttribute, 1);
+
+        uniforms.create(shapeUniformBinding, sceneTextures.size());
+        program = shaders.program(spriteShader);
+        glState().useProgram(program);
+        glUniform1i(glGetUniformLocation(program, "uTexture"), 0);
+        bindUniformBlock(program, "Frame", frameUniformBinding);
+        bindUniformBlock(program, "Shape", shapeUniformBinding);
+    }
+
+    // Uploads the textures that finished loading; true if any did
+    bool poll()
+    {
+        bool changed = false;
+        for (SceneTexture& t : sceneTextures)
+            changed |= pollTexture(t.texture);
+        return changed;
+    }
+
+    bool loading() const
+    {
+        for (const SceneTexture& t : sceneTextures)
+            if (t.texture.state == TextureState::Loading)
+                return true;
+        return false;
+    }
+
+    // Sprites whose texture is not ready yet are drawn in `placeholder`
+    void draw(TextureResidency& residency, const float* placeholder)
+    {
+        glState().useProgram(program);
+        for (size_t i = 0; i < sceneTextures.size(); ++i) {
+            bool ready = sceneTextures[i].texture.state == TextureState::Ready;
+            for (int c = 0; c < 4; ++c)
+                uniforms[i].color[c] = ready ? 1.0f : placeholder[c];
+            uniforms[i].minMix = ready ? 0.0f : 1.0f;
+        }
+        uniforms.upload(sceneTextures.size());
+
+        meshes->bind(meshes->mesh(shapeMeshes[0]).format);
+        glState().bindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        for (const Group& g : groups) {
+            LazyTexture& tex = sceneTextures[g.texture].texture;
+            residency.markVisible(tex);
+            if (tex.state == TextureState::Ready) {
+                glState().activeTexture(GL_TEXTURE0);
+                glState().bindTexture(GL_TEXTURE_2D, tex.id);
+            }
+            uniforms.bind(g.texture);
+            glVertexAttribPointer(instanceAttribute, 4, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance),
+                                  (void*)(g.first * sizeof(SpriteInstance)));
+            meshes->drawInstanced(g.mesh, g.count);
+        }
+    }
+
+    void destroy()
+    {
+        for (SceneTexture& t : sceneTextures)
+            destroyTexture(t.texture);
+        uniforms.destroy();
+        glState().forgetBuffer(instanceBuffer);
+        glDeleteBuffers(1, &instanceBuffer);
+        glDeleteProgram(program);
+        instanceBuffer = program = 0;
+    }
+
+private:
+    static const GLuint instanceAttribute = 2;
+
+    struct Sprite {
+        SpriteInstance instance;
+        int texture = 0;
+        int shape = 0; // 0 quad, 1 triangle
+    };
+
+    // Instances [first, first + count) share a texture and a shape
+    struct Group {
+        int texture, mesh;
+        GLint first;
+        GLsizei count;
+    };
+
+    std::deque<SceneTexture> sceneTextures;
+    std::vector<Sprite> sprites;
+    std::vector<Group> groups;
+    MeshRegistry* meshes = nullptr; // the app's, which owns the shapes
+    int shapeMeshes[2] = {};
+    UniformBlockArray<ShapeUniforms> uniforms; // one per texture
+    size_t instanceCount = 0; // once built
+    GLuint instanceBuffer = 0, program = 0;
+
+    static size_t key(const Sprite& s) { return (size_t)s.texture * 2 + s.shape; }
+
+    void addTexture(const std::string& name, const std::string& path)
+    {
+        sceneTextures.emplace_back();
+        SceneTexture& t = sceneTextures.back();
+        t.name = name;
+        t.path = path;
+        t.texture.path = t.path.c_str();
+    }
+
+    int findTexture(const std::string& name) const
+    {
+        for (size_t i = 0; i < sceneTextures.size(); ++i)
+            if (sceneTextures[i].name == name)
+                return (int)i;
+        return -1;
+    }
+
+    void scatter(long count, int shape, int texture, float minScale, float maxScale, float mix, int seed)
+    {
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> position(-1.0f, 1.0f), scale(minScale, maxScale);
+        sprites.reserve(sprites.size() + count);
+        for (long i = 0; i < count; ++i) {
+            Sprite s;
+            s.instance.x = position(random);
+            s.instance.y = position(random);
+            s.instance.scale = scale(random);
+            s.instance.mix = mix;
+            s.texture = texture;
+            s.shape = shape;
+            sprites.push_back(s);
+        }
+    }
+};
@@ -524,6 +524,22 @@ STBIDEF void stbi_set_unpremultiply_on_load_thread(int flag_true_if_should_unpre
 STBIDEF void stbi_convert_iphone_png_to_rgb_thread(int flag_true_if_should_convert);
 STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_flip);
 
+// decoder contexts keep the scratch allocations of a decode (JPEG decoder
+// state, component planes, zlib and PNG filter buffers) and hand them to the
+// next decode instead of going back to STBI_MALLOC, so loading many images
+// of similar size stops paying for fresh allocations and page faults. the
+// cached blocks grow to the largest image seen and are released by
+// stbi_decoder_context_free. the returned images are always the caller's.
+// a context must not be used by two threads at once; give each worker
+// thread its own through the _thread variant (same availability rules as
+// the _thread functions above). define STBI_NO_DECODER_CONTEXT to compile
+// the feature out.
+typedef struct stbi_decoder_context stbi_decoder_context;
+STBIDEF stbi_decoder_context *stbi_decoder_context_create(void);
+STBIDEF void stbi_decoder_context_free(stbi_decoder_context *ctx);
+STBIDEF void stbi_set_decoder_context(stbi_decoder_context *ctx);
+STBIDEF void stbi_set_decoder_context_thread(stbi_decoder_context *ctx);
+
 // ZLIB client - used by PNG, available for other purposes
 
 STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen);
@@ -688,6 +704,25 @@ typedef unsigned char validate_uint32[sizeof(stbi__uint32)==4 ? 1 : -1];
 #define STBI_REALLOC_SIZED(p,oldsz,newsz) STBI_REALLOC(p,newsz)
 #endif
 
+// Instrumentation hooks, no-ops unless defined beforehand (see stbi_instrument.h)
+#ifndef STBI_DECODE_BEGIN
+#define STBI_DECODE_BEGIN()
+#define STBI_DECODE_END(result,x,y,comp)
+#define STBI_DECODE_FORMAT(name)
+#define STBI_PHASE(phase)
+#endif
+
+// Progress hook for streaming consumers: called as rows of the final 8-bit
+// output buffer are completed (JPEG, and PNGs whose output needs no further
+// conversion). Rows [0, rows) of pixels, comp bytes per pixel, are final and
+// will not be written again, and once a row is reported the decode cannot
+// fail, so pixels stays allocated until it is handed to the caller. Not
+// called when rows are reordered afterwards by
+// stbi_set_flip_vertically_on_load.
+#ifndef STBI_ROWS_DONE
+#define STBI_ROWS_DONE(pixels,rows,comp) ((void)0)
+#endif
+
 // x86/x64 detection
 #if defined(__x86_64__) || defined(_M_X64)
 #define STBI__X64_TARGET
@@ -982,10 +1017,211 @@ static int stbi__err(const char *str)
 }
 #endif
 
+#ifndef STBI_NO_DECODER_CONTEXT
+// blocks allocated inside a decode are tracked in `live` until freed (then
+// they move to `cache`) or until the decode ends, at which point whatever
+// is still live belongs to the caller and is forgotten
+#ifndef STBI_DECODER_CONTEXT_SLOTS
+#define STBI_DECODER_CONTEXT_SLOTS 32
+#endif
+
+typedef struct
+{
+   void *p;
+   size_t size;
+} stbi__block;
+
+struct stbi_decoder_context
+{
+   int depth;
+   int num_live, num_cached;
+   stbi__block live[STBI_DECODER_CONTEXT_SLOTS];
+   stbi__block cached[STBI_DECODER_CONTEXT_SLOTS];
+};
+
+// the allocator behind the context, with the user's STBI_MALLOC etc.
+static void *stbi__sys_malloc(size_t size) { return STBI_MALLOC(size); }
+static void *stbi__sys_realloc(void *p, size_t oldsz, size_t newsz) { (void) oldsz; return STBI_REALLOC_SIZED(p, oldsz, newsz); }
+static void  stbi__sys_free(void *p) { STBI_FREE(p); }
+
+static stbi_decoder_context *stbi__decoder_context_global;
+
+STBIDEF void stbi_set_decoder_context(stbi_decoder_context *ctx)
+{
+   stbi__decoder_context_global = ctx;
+}
+
+#ifndef STBI_THREAD_LOCAL
+#define stbi__decoder_context  stbi__decoder_context_global
+#else
+static STBI_THREAD_LOCAL stbi_decoder_context *stbi__decoder_context_local;
+static STBI_THREAD_LOCAL int stbi__decoder_context_set;
+
+STBIDEF void stbi_set_decoder_context_thread(stbi_decoder_context *ctx)
+{
+   stbi__decoder_context_local = ctx;
+   stbi__decoder_context_set = 1;
+}
+
+#define stbi__decoder_context  (stbi__decoder_context_set           \
+                                 ? stbi__decoder_context_local      \
+                                 : stbi__decoder_context_global)
+#endif // STBI_THREAD_LOCAL
+
+STBIDEF stbi_decoder_context *stbi_decoder_context_create(void)
+{
+   stbi_decoder_context *ctx = (stbi_decoder_context *) stbi__sys_malloc(sizeof(*ctx));
+   if (ctx) memset(ctx, 0, sizeof(*ctx));
+   return ctx;
+}
+
+STBIDEF void stbi_decoder_context_free(stbi_decoder_context *ctx)
+{
+   int i;
+   if (!ctx) return;
+   for (i=0; i < ctx->num_cached; ++i)
+      stbi__sys_free(ctx->cached[i].p);
+   stbi__sys_free(ctx);
+}
+
+// the context active for the current decode, or NULL
+static stbi_decoder_context *stbi__active_context(void)
+{
+   stbi_decoder_context *ctx = stbi__decoder_context;
+   return ctx && ctx->depth ? ctx : NULL;
+}
+
+static void stbi__context_enter(void)
+{
+   stbi_decoder_context *ctx = stbi__decoder_context;
+   if (ctx) ++ctx->depth;
+}
+
+static void stbi__context_leave(void)
+{
+   stbi_decoder_context *ctx = stbi__decoder_context;
+   if (ctx && ctx->depth && --ctx->depth == 0)
+      ctx->num_live = 0;
+}
+
+static int stbi__find_block(stbi__block *blocks, int n, void *p)
+{
+   int i;
+   for (i=0; i < n; ++i)
+      if (blocks[i].p == p) return i;
+   return -1;
+}
+
+static void stbi__track_live(stbi_decoder_context *ctx, void *p, size_t size)
+{
+   if (p && ctx->num_live < STBI_DECODER_CONTEXT_SLOTS) {
+      ctx->live[ctx->num_live].p = p;
+      ctx->live[ctx->num_live].size = size;
+      ++ctx->num_live;
+   }
+}
+
+// smallest cached block that holds size bytes without wasting most of it
+static int stbi__best_cached(stbi_decoder_context *ctx, size_t size)
+{
+   int i, best = -1;
+   for (i=0; i < ctx->num_cached; ++i) {
+      size_t have = ctx->cached[i].size;
+      if (have >= size && have / 4 <= size && (best < 0 || have < ctx->cached[best].size))
+         best = i;
+   }
+   return best;
+}
+
+static void *stbi__ctx_malloc(size_t size)
+{
+   stbi_decoder_context *ctx = stbi__active_context();
+   void *p;
+   int i;
+   if (!ctx) return stbi__sys_malloc(size);
+   i = stbi__best_cached(ctx, size);
+   if (i >= 0) {
+      stbi__block b = ctx->cached[i];
+      ctx->cached[i] = ctx->cached[--ctx->num_cached];
+      stbi__track_live(ctx, b.p, b.size);
+      return b.p;
+   }
+   p = stbi__sys_malloc(size);
+   stbi__track_live(ctx, p, size);
+   return p;
+}
+
+static void stbi__ctx_free(void *p)
+{
+   stbi_decoder_context *ctx = stbi__active_context();
+   stbi__block b;
+   int i;
+   if (!p) return;
+   if (!ctx || (i = stbi__find_block(ctx->live, ctx->num_live, p)) < 0) {
+      stbi__sys_free(p);
+      return;
+   }
+   b = ctx->live[i];
+   ctx->live[i] = ctx->live[--ctx->num_live];
+   if (ctx->num_cached == STBI_DECODER_CONTEXT_SLOTS) {
+      // full: keep the larger of the new block and the smallest cached one
+      int smallest = 0;
+      for (i=1; i < ctx->num_cached; ++i)
+         if (ctx->cached[i].size < ctx->cached[smallest].size) smallest = i;
+      if (ctx->cached[smallest].size >= b.size) {
+         stbi__sys_free(b.p);
+         return;
+      }
+      stbi__sys_free(ctx->cached[smallest].p);
+      ctx->cached[smallest] = ctx->cached[--ctx->num_cached];
+   }
+   ctx->cached[ctx->num_cached++] = b;
+}
+
+static void *stbi__ctx_realloc(void *p, size_t oldsz, size_t newsz)
+{
+   stbi_decoder_context *ctx = stbi__active_context();
+   int i, j;
+   if (!ctx || !p || (i = stbi__find_block(ctx->live, ctx->num_live, p)) < 0)
+      return stbi__sys_realloc(p, oldsz, newsz);
+   if (ctx->live[i].size >= newsz)
+      return p; // the recycled block is already big enough
+   j = stbi__best_cached(ctx, newsz);
+   if (j >= 0) {
+      stbi__block b = ctx->cached[j];
+      memcpy(b.p, p, oldsz < ctx->live[i].size ? oldsz : ctx->live[i].size);
+      ctx->cached[j].p = p;
+      ctx->cached[j].size = ctx->live[i].size;
+      ctx->live[i] = b;
+      return b.p;
+   }
+   p = stbi__sys_realloc(p, oldsz, newsz);
+   if (p) {
+      ctx->live[i].p = p;
+      ctx->live[i].size = newsz;
+   }
+   return p;
+}
+
+// from here on every allocation of the decoders goes through the context
+#undef STBI_FREE
+#define STBI_FREE(p)                      stbi__ctx_free(p)
+#undef STBI_REALLOC_SIZED
+#define STBI_REALLOC_SIZED(p,oldsz,newsz) stbi__ctx_realloc(p,oldsz,newsz)
+
+static void *stbi__malloc(size_t size)
+{
+    return stbi__ctx_malloc(size);
+}
+#else
+#define stbi__context_enter()
+#define stbi__context_leave()
+
 static void *stbi__malloc(size_t size)
 {
     return STBI_MALLOC(size);
 }
+#endif // STBI_NO_DECODER_CONTEXT
 
 // stb_image uses ints pervasively, including for offset calculations.
 // therefore the largest decoded image size we can support with the
@@ -1144,44 +1380,48 @@ static void *stbi__load_main(stbi__context *s, int *x, int *y, int *comp, int re
    // test the formats with a very explicit header first (at least a FOURCC
    // or distinctive magic number first)
    #ifndef STBI_NO_PNG
-   if (stbi__png_test(s))  return stbi__png_load(s,x,y,comp,req_comp, ri);
+   if (stbi__png_test(s)) { STBI_DECODE_FORMAT("png"); return stbi__png_load(s,x,y,comp,req_comp, ri); }
    #endif
    #ifndef STBI_NO_BMP
-   if (stbi__bmp_test(s))  return stbi__bmp_load(s,x,y,comp,req_comp, ri);
+   if (stbi__bmp_test(s)) { STBI_DECODE_FORMAT("bmp"); return stbi__bmp_load(s,x,y,comp,req_comp, ri); }
    #endif
    #ifndef STBI_NO_GIF
-   if (stbi__gif_test(s))  return stbi__gif_load(s,x,y,comp,req_comp, ri);
+   if (stbi__gif_test(s)) { STBI_DECODE_FORMAT("gif"); return stbi__gif_load(s,x,y,comp,req_comp, ri); }
    #endif
    #ifndef STBI_NO_PSD
-   if (stbi__psd_test(s))  return stbi__psd_load(s,x,y,comp,req_comp, ri, bpc);
+   if (stbi__psd_test(s)) { STBI_DECODE_FORMAT("psd"); return stbi__psd_load(s,x,y,comp,req_comp, ri, bpc); }
    #else
    STBI_NOTUSED(bpc);
    #endif
    #ifndef STBI_NO_PIC
-   if (stbi__pic_test(s))  return stbi__pic_load(s,x,y,comp,req_comp, ri);
+   if (stbi__pic_test(s)) { STBI_DECODE_FORMAT("pic"); return stbi__pic_load(s,x,y,comp,req_comp, ri); }
    #endif
 
    // then the formats that can end up attempting to load with just 1 or 2
    // bytes matching expectations; these are prone to false positives, so
    // try them later
    #ifndef STBI_NO_JPEG
-   if (stbi__jpeg_test(s)) return stbi__jpeg_load(s,x,y,comp,req_comp, ri);
+   if (stbi__jpeg_test(s)) { STBI_DECODE_FORMAT("jpeg"); return stbi__jpeg_load(s,x,y,comp,req_comp, ri); }
    #endif
    #ifndef STBI_NO_PNM
-   if (stbi__pnm_test(s))  return stbi__pnm_load(s,x,y,comp,req_comp, ri);
+   if (stbi__pnm_test(s)) { STBI_DECODE_FORMAT("pnm"); return stbi__pnm_load(s,x,y,comp,req_comp, ri); }
    #endif
 
    #ifndef STBI_NO_HDR
    if (stbi__hdr_test(s)) {
-      float *hdr = stbi__hdr_load(s, x,y,comp,req_comp, ri);
+      float *hdr;
+      STBI_DECODE_FORMAT("hdr");
+      hdr = stbi__hdr_load(s, x,y,comp,req_comp, ri);
       return stbi__hdr_to_ldr(hdr, *x, *y, req_comp ? req_comp : *comp);
    }
    #endif
 
    #ifndef STBI_NO_TGA
    // test tga last because it's a crappy test!
-   if (stbi__tga_test(s))
+   if (stbi__tga_test(s)) {
+      STBI_DECODE_FORMAT("tga");
       return stbi__tga_load(s,x,y,comp,req_comp, ri);
+   }
    #endif
 
    return stbi__errpuc("unknown image type", "Image not of any known type, or corrupt");
@@ -1260,15 +1500,22 @@ static void stbi__vertical_flip_slices(void *image, int w, int h, int z, int byt
 static unsigned char *stbi__load_and_postprocess_8bit(stbi__context *s, int *x, int *y, int *comp, int req_comp)
 {
    stbi__result_info ri;
-   void *result = stbi__load_main(s, x, y, comp, req_comp, &ri, 8);
-
-   if (result == NULL)
+   void *result;
+   STBI_DECODE_BEGIN();
+   stbi__context_enter();
+   result = stbi__load_main(s, x, y, comp, req_comp, &ri, 8);
+
+   if (result == NULL) {
+      stbi__context_leave();
+      STBI_DECODE_END(NULL, 0, 0, 0);
       return NULL;
+   }
 
    // it is the responsibility of the loaders to make sure we get either 8 or 16 bit.
    STBI_ASSERT(ri.bits_per_channel == 8 || ri.bits_per_channel == 16);
 
    if (ri.bits_per_channel != 8) {
+      STBI_PHASE(STBI_PHASE_COLOR);
       result = stbi__convert_16_to_8((stbi__uint16 *) result, *x, *y, req_comp == 0 ? *comp : req_comp);
       ri.bits_per_channel = 8;
    }
@@ -1277,24 +1524,34 @@ static unsigned char *stbi__load_and_postprocess_8bit(stbi__context *s, int *x,
 
    if (stbi__vertically_flip_on_load) {
       int channels = req_comp ? req_comp : *comp;
+      STBI_PHASE(STBI_PHASE_FLIP);
       stbi__vertical_flip(result, *x, *y, channels * sizeof(stbi_uc));
    }
 
+   stbi__context_leave();
+   STBI_DECODE_END(result, *x, *y, req_comp ? req_comp : *comp);
    return (unsigned char *) result;
 }
 
 static stbi__uint16 *stbi__load_and_postprocess_16bit(stbi__context *s, int *x, int *y, int *comp, int req_comp)
 {
    stbi__result_info ri;
-   void *result = stbi__load_main(s, x, y, comp, req_comp, &ri, 16);
-
-   if (result == NULL)
+   void *result;
+   STBI_DECODE_BEGIN();
+   stbi__context_enter();
+   result = stbi__load_main(s, x, y, comp, req_comp, &ri, 16);
+
+   if (result == NULL) {
+      stbi__context_leave();
+      STBI_DECODE_END(NULL, 0, 0, 0);
       return NULL;
+   }
 
    // it is the responsibility of the loaders to make sure we get either 8 or 16 bit.
    STBI_ASSERT(ri.bits_per_channel == 8 || ri.bits_per_channel == 16);
 
    if (ri.bits_per_channel != 16) {
+      STBI_PHASE(STBI_PHASE_COLOR);
       result = stbi__convert_8_to_16((stbi_uc *) result, *x, *y, req_comp == 0 ? *comp : req_comp);
       ri.bits_per_channel = 16;
    }
@@ -1304,9 +1561,12 @@ static stbi__uint16 *stbi__load_and_postprocess_16bit(stbi__context *s, int *x,
 
    if (stbi__vertically_flip_on_load) {
       int channels = req_comp ? req_comp : *comp;
+      STBI_PHASE(STBI_PHASE_FLIP);
       stbi__vertical_flip(result, *x, *y, channels * sizeof(stbi__uint16));
    }
 
+   stbi__context_leave();
+   STBI_DECODE_END(result, *x, *y, req_comp ? req_comp : *comp);
    return (stbi__uint16 *) result;
 }
 
@@ -1315,6 +1575,7 @@ static void stbi__float_postprocess(float *result, int *x, int *y, int *comp, in
 {
    if (stbi__vertically_flip_on_load && result != NULL) {
       int channels = req_comp ? req_comp : *comp;
+      STBI_PHASE(STBI_PHASE_FLIP);
       stbi__vertical_flip(result, *x, *y, channels * sizeof(float));
    }
 }
@@ -1463,9 +1724,15 @@ static float *stbi__loadf_main(stbi__context *s, int *x, int *y, int *comp, int
    #ifndef STBI_NO_HDR
    if (stbi__hdr_test(s)) {
       stbi__result_info ri;
-      float *hdr_data = stbi__hdr_load(s,x,y,comp,req_comp, &ri);
+      float *hdr_data;
+      STBI_DECODE_BEGIN();
+      STBI_DECODE_FORMAT("hdr");
+      stbi__context_enter();
+      hdr_data = stbi__hdr_load(s,x,y,comp,req_comp, &ri);
       if (hdr_data)
          stbi__float_postprocess(hdr_data,x,y,comp,req_comp);
+      stbi__context_leave();
+      STBI_DECODE_END(hdr_data, *x, *y, req_comp ? req_comp : *comp);
       return hdr_data;
    }
    #endif
@@ -1758,6 +2025,7 @@ static unsigned char *stbi__convert_format(unsigned char *data, int img_n, int r
    unsigned char *good;
 
    if (req_comp == img_n) return data;
+   STBI_PHASE(STBI_PHASE_COLOR);
    STBI_ASSERT(req_comp >= 1 && req_comp <= 4);
 
    good = (unsigned char *) stbi__malloc_mad3(req_comp, x, y, 0);
@@ -1815,6 +2083,7 @@ static stbi__uint16 *stbi__convert_format16(stbi__uint16 *data, int img_n, int r
    stbi__uint16 *good;
 
    if (req_comp == img_n) return data;
+   STBI_PHASE(STBI_PHASE_COLOR);
    STBI_ASSERT(req_comp >= 1 && req_comp <= 4);
 
    good = (stbi__uint16 *) stbi__malloc(req_comp * x * y * 2);
@@ -2964,7 +3233,9 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
             for (i=0; i < w; ++i) {
                int ha = z->img_comp[n].ha;
                if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+               STBI_PHASE(STBI_PHASE_IDCT);
                z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               STBI_PHASE(STBI_PHASE_ENTROPY);
                // every data block is an MCU, so countdown the restart interval
                if (--z->todo <= 0) {
                   if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
@@ -2992,7 +3263,9 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
                         int y2 = (j*z->img_comp[n].v + y)*8;
                         int ha = z->img_comp[n].ha;
                         if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+                        STBI_PHASE(STBI_PHASE_IDCT);
                         z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data);
+                        STBI_PHASE(STBI_PHASE_ENTROPY);
                      }
                   }
                }
@@ -3082,6 +3355,7 @@ static void stbi__jpeg_finish(stbi__jpeg *z)
    if (z->progressive) {
       // dequantize and idct the data
       int i,j,n;
+      STBI_PHASE(STBI_PHASE_IDCT);
       for (n=0; n < z->s->img_n; ++n) {
          int w = (z->img_comp[n].x+7) >> 3;
          int h = (z->img_comp[n].y+7) >> 3;
@@ -3417,12 +3691,15 @@ static int stbi__decode_jpeg_image(stbi__jpeg *j)
       j->img_comp[m].raw_coeff = NULL;
    }
    j->restart_interval = 0;
+   STBI_PHASE(STBI_PHASE_HEADER);
    if (!stbi__decode_jpeg_header(j, STBI__SCAN_load)) return 0;
    m = stbi__get_marker(j);
    while (!stbi__EOI(m)) {
       if (stbi__SOS(m)) {
          if (!stbi__process_scan_header(j)) return 0;
+         STBI_PHASE(STBI_PHASE_ENTROPY);
          if (!stbi__parse_entropy_coded_data(j)) return 0;
+         STBI_PHASE(STBI_PHASE_HEADER);
          if (j->marker == STBI__MARKER_none ) {
          j->marker = stbi__skip_jpeg_junk_at_end(j);
             // if we reach eof without hitting a marker, stbi__get_marker() below will fail and we'll eventually return 0
@@ -3888,6 +4165,7 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
    if (decode_n <= 0) { stbi__cleanup_jpeg(z); return NULL; }
 
    // resample and color-convert
+   STBI_PHASE(STBI_PHASE_COLOR);
    {
       int k;
       unsigned int i,j;
@@ -4016,6 +4294,8 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
                   for (i=0; i < z->s->img_x; ++i) { *out++ = y[i]; *out++ = 255; }
             }
          }
+         if (!stbi__vertically_flip_on_load)
+            STBI_ROWS_DONE(output, (int) j+1, n);
       }
       stbi__cleanup_jpeg(z);
       *out_x = z->s->img_x;
@@ -4632,6 +4912,7 @@ typedef struct
    stbi__context *s;
    stbi_uc *idata, *expanded, *out;
    int depth;
+   int report_rows; // a->out is the final output, see STBI_ROWS_DONE
 } stbi__png;
 
 
@@ -4734,6 +5015,18 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
       width = img_width_bytes;
    }
 
+   // Reported rows are read by another thread while the decode goes on, so
+   // report none unless every row will decode: a bad filter byte further
+   // down would free a->out under the reader
+   if (a->report_rows) {
+      for (j=0; j < y; ++j) {
+         if (raw[j * (img_width_bytes + 1)] > 4) {
+            a->report_rows = 0;
+            break;
+         }
+      }
+   }
+
    for (j=0; j < y; ++j) {
       // cur/prior filter buffers alternate
       stbi_uc *cur = filter_buf + (j & 1)*img_width_bytes;
@@ -4850,6 +5143,8 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
             }
          }
       }
+      if (a->report_rows)
+         STBI_ROWS_DONE(a->out, (int) j+1, out_n);
    }
 
    STBI_FREE(filter_buf);
@@ -5087,6 +5382,8 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
    z->expanded = NULL;
    z->idata = NULL;
    z->out = NULL;
+   z->report_rows = 0;
+   STBI_PHASE(STBI_PHASE_HEADER);
 
    if (!stbi__check_png_header(s)) return 0;
 
@@ -5204,6 +5501,7 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
             // initial guess for decoded data size to avoid unnecessary reallocs
             bpl = (s->img_x * z->depth + 7) / 8; // bytes per line, per component
             raw_len = bpl * s->img_y * s->img_n /* pixels */ + s->img_y /* filter mode per row */;
+            STBI_PHASE(STBI_PHASE_ENTROPY);
             z->expanded = (stbi_uc *) stbi_zlib_decode_malloc_guesssize_headerflag((char *) z->idata, ioff, raw_len, (int *) &raw_len, !is_iphone);
             if (z->expanded == NULL) return 0; // zlib should set error
             STBI_FREE(z->idata); z->idata = NULL;
@@ -5211,6 +5509,9 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
                s->img_out_n = s->img_n+1;
             else
                s->img_out_n = s->img_n;
+            z->report_rows = !pal_img_n && !has_trans && !is_iphone && !interlace && z->depth == 8 &&
+                             (req_comp == 0 || req_comp == s->img_out_n) && !stbi__vertically_flip_on_load;
+            STBI_PHASE(STBI_PHASE_UNFILTER);
             if (!stbi__create_png_image(z, z->expanded, raw_len, s->img_out_n, z->depth, color, interlace)) return 0;
             if (has_trans) {
                if (z->depth == 16) {
@@ -0,0 +1,270 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Allocation and phase instrumentation for stb_image.h.
+//
+// Include this before the stb_image.h implementation (the translation unit
+// that defines STB_IMAGE_IMPLEMENTATION). It routes STBI_MALLOC/STBI_REALLOC/
+// STBI_FREE through size-tracking wrappers and fills in the STBI_DECODE_* and
+// STBI_PHASE hooks, so every stbi_load* call records its allocation count,
+// allocated bytes, high-water mark of live decoder memory and the time spent
+// in each decode phase. Phase times are exclusive: while the IDCT of a
+// baseline JPEG block runs, the entropy phase is paused.
+//
+// Results are available through stbiDecodeStats()/stbiLastDecodeStats() and
+// are printed to stderr at exit unless stbiSetDumpAtExit(false) is called.
+
+enum StbiPhase {
+    STBI_PHASE_HEADER,   // headers, markers, chunk parsing
+    STBI_PHASE_ENTROPY,  // Huffman (JPEG) / inflate (PNG)
+    STBI_PHASE_IDCT,     // JPEG dequantize + inverse DCT
+    STBI_PHASE_UNFILTER, // PNG scanline filters and bit-depth expansion
+    STBI_PHASE_COLOR,    // resampling, color space and req_comp conversion
+    STBI_PHASE_FLIP,     // stbi_set_flip_vertically_on_load
+    STBI_PHASE_DECODE,   // formats without finer-grained hooks
+    STBI_PHASE_COUNT
+};
+
+inline const char* stbiPhaseName(int phase)
+{
+    static const char* names[STBI_PHASE_COUNT] = {
+        "header", "entropy", "idct", "unfilter", "color", "flip", "decode"
+    };
+    return names[phase];
+}
+
+struct StbiDecodeStats {
+    const char* format = "unknown";
+    bool ok = false;
+    int width = 0, height = 0, channels = 0;
+    size_t allocCount = 0;
+    size_t allocBytes = 0;
+    size_t peakBytes = 0; // high-water mark of memory allocated during the decode
+    double totalSeconds = 0;
+    double phaseSeconds[STBI_PHASE_COUNT] = {};
+};
+
+class StbiInstrument {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Every block carries its size in front so frees can be accounted
+    static constexpr size_t headerSize = 16;
+
+    static void* allocate(size_t size)
+    {
+        unsigned char* block = (unsigned char*)std::malloc(size + headerSize);
+        if (!block)
+            return nullptr;
+        *(size_t*)block = size;
+        track(size, 0);
+        return block + headerSize;
+    }
+
+    static void* reallocate(void* p, size_t size)
+    {
+        if (!p)
+            return allocate(size);
+        unsigned char* block = (unsigned char*)p - headerSize;
+        size_t old = *(size_t*)block;
+        block = (unsigned char*)std::realloc(block, size + headerSize);
+        if (!block)
+            return nullptr;
+        *(size_t*)block = size;
+        track(size, old);
+        return block + headerSize;
+    }
+
+    static void release(void* p)
+    {
+        if (!p)
+            return;
+        unsigned char* block = (unsigned char*)p - headerSize;
+        thread().live -= (long long)*(size_t*)block;
+        std::free(block);
+    }
+
+    // Nested decodes (stbi_loadf on an LDR image) are folded into the outer one
+    static void beginDecode()
+    {
+        ThreadState& t = thread();
+        if (t.depth++)
+            return;
+        t.current = StbiDecodeStats();
+        t.base = t.live;
+        t.decodeStart = t.phaseStart = Clock::now();
+        t.phase = STBI_PHASE_HEADER;
+    }
+
+    static void setFormat(const char* name)
+    {
+        ThreadState& t = thread();
+        t.current.format = name;
+        std::string format = name;
+        if (format != "jpeg" && format != "png")
+            setPhase(STBI_PHASE_DECODE);
+    }
+
+    static void setPhase(int phase)
+    {
+        ThreadState& t = thread();
+        if (!t.depth)
+            return;
+        Clock::time_point now = Clock::now();
+        t.current.phaseSeconds[t.phase] += std::chrono::duration<double>(now - t.phaseStart).count();
+        t.phase = phase;
+        t.phaseStart = now;
+    }
+
+    static void endDecode(const void* result, int w, int h, int comp)
+    {
+        ThreadState& t = thread();
+        if (--t.depth)
+            return;
+        closePhase(t);
+        t.current.ok = result != nullptr;
+        t.current.width = w;
+        t.current.height = h;
+        t.current.channels = comp;
+        t.current.totalSeconds = std::chrono::duration<double>(Clock::now() - t.decodeStart).count();
+        t.last = t.current;
+
+        std::lock_guard<std::mutex> lock(shared().mutex);
+        shared().results.push_back(t.current);
+        if (!shared().atexitRegistered) {
+            shared().atexitRegistered = true;
+            std::atexit([] {
+                if (shared().dumpAtExit)
+                    dump(stderr);
+            });
+        }
+    }
+
+    static std::vector<StbiDecodeStats> results()
+    {
+        std::lock_guard<std::mutex> lock(shared().mutex);
+        return shared().results;
+    }
+
+    static StbiDecodeStats last() { return thread().last; }
+
+    static void reset()
+    {
+        std::lock_guard<std::mutex> lock(shared().mutex);
+        shared().results.clear();
+    }
+
+    static void setDumpAtExit(bool enabled) { shared().dumpAtExit = enabled; }
+
+    // Per-decode table followed by per-format totals
+    static void dump(FILE* out)
+    {
+        std::vector<StbiDecodeStats> all = results();
+        if (all.empty())
+            return;
+        fprintf(out, "stb_image decode stats (%zu decodes)\n", all.size());
+        fprintf(out, "%-6s %11s %7s %10s %10s %9s", "format", "size", "allocs", "alloc KB", "peak KB", "total ms");
+        for (int p = 0; p < STBI_PHASE_COUNT; ++p)
+            fprintf(out, " %8s", stbiPhaseName(p));
+        fprintf(out, "\n");
+
+        std::map<std::string, StbiDecodeStats> totals;
+        for (const StbiDecodeStats& s : all) {
+            char size[32];
+            snprintf(size, sizeof(size), "%dx%d", s.width, s.height);
+            fprintf(out, "%-6s %11s %7zu %10zu %10zu %9.3f", s.format, s.ok ? size : "failed",
+                    s.allocCount, s.allocBytes / 1024, s.peakBytes / 1024, s.totalSeconds * 1e3);
+            for (int p = 0; p < STBI_PHASE_COUNT; ++p)
+                fprintf(out, " %8.3f", s.phaseSeconds[p] * 1e3);
+            fprintf(out, "\n");
+
+            StbiDecodeStats& t = totals[s.format];
+            t.format = s.format;
+            t.width += 1; // decode count
+            t.allocCount += s.allocCount;
+            t.allocBytes += s.allocBytes;
+            t.peakBytes = std::max(t.peakBytes, s.peakBytes);
+            t.totalSeconds += s.totalSeconds;
+            for (int p = 0; p < STBI_PHASE_COUNT; ++p)
+                t.phaseSeconds[p] += s.phaseSeconds[p];
+        }
+        for (const auto& entry : totals) {
+            const StbiDecodeStats& t = entry.second;
+            fprintf(out, "total %-6s x%-4d allocs %zu, %zu KB, peak %zu KB, %.3f ms:", t.format, t.width,
+                    t.allocCount, t.allocBytes / 1024, t.peakBytes / 1024, t.totalSeconds * 1e3);
+            for (int p = 0; p < STBI_PHASE_COUNT; ++p)
+                if (t.phaseSeconds[p] > 0)
+                    fprintf(out, " %s %.3f", stbiPhaseName(p), t.phaseSeconds[p] * 1e3);
+            fprintf(out, "\n");
+        }
+    }
+
+private:
+    struct ThreadState {
+        int depth = 0;
+        long long live = 0; // bytes allocated minus freed on this thread
+        long long base = 0; // live at the start of the current decode
+        int phase = STBI_PHASE_HEADER;
+        Clock::time_point decodeStart, phaseStart;
+        StbiDecodeStats current, last;
+    };
+
+    struct Shared {
+        std::mutex mutex;
+        std::vector<StbiDecodeStats> results;
+        bool dumpAtExit = true;
+        bool atexitRegistered = false;
+    };
+
+    static ThreadState& thread()
+    {
+        thread_local ThreadState state;
+        return state;
+    }
+
+    static Shared& shared()
+    {
+        static Shared* state = new Shared; // outlives the atexit dump
+        return *state;
+    }
+
+    static void closePhase(ThreadState& t)
+    {
+        t.current.phaseSeconds[t.phase] += std::chrono::duration<double>(Clock::now() - t.phaseStart).count();
+        t.phaseStart = Clock::now();
+    }
+
+    static void track(size_t size, size_t freed)
+    {
+        ThreadState& t = thread();
+        t.live += (long long)size - (long long)freed;
+        if (!t.depth)
+            return;
+        ++t.current.allocCount;
+        t.current.allocBytes += size;
+        if (t.live - t.base > (long long)t.current.peakBytes)
+            t.current.peakBytes = (size_t)(t.live - t.base);
+    }
+};
+
+inline std::vector<StbiDecodeStats> stbiDecodeStats() { return StbiInstrument::results(); }
+inline StbiDecodeStats stbiLastDecodeStats() { return StbiInstrument::last(); }
+inline void stbiResetDecodeStats() { StbiInstrument::reset(); }
+inline void stbiSetDumpAtExit(bool enabled) { StbiInstrument::setDumpAtExit(enabled); }
+inline void stbiDumpDecodeStats(FILE* out) { StbiInstrument::dump(out); }
+
+#define STBI_MALLOC(sz)                  StbiInstrument::allocate(sz)
+#define STBI_REALLOC(p, newsz)           StbiInstrument::reallocate(p, newsz)
+#define STBI_FREE(p)                     StbiInstrument::release(p)
+#define STBI_DECODE_BEGIN()              StbiInstrument::beginDecode()
+#define STBI_DECODE_END(result, x, y, c) StbiInstrument::endDecode(result, x, y, c)
+#define STBI_DECODE_FORMAT(name)         StbiInstrument::setFormat(name)
+#define STBI_PHASE(phase)                StbiInstrument::setPhase(phase)
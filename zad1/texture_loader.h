@@ -0,0 +1,458 @@
+#pragma once
+#include <glad/glad.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../common/cpu_profiler.h"
+#include "../common/gl_state.h"
+#include "asset_bundle.h"
+#include "stb_image.h"
+
+// Demand-driven texture loading: the JPEG is decoded on a worker thread the
+// first time it is requested and uploaded on the render thread once ready.
+//
+// The worker probes the header first, so the render thread can allocate the
+// texture storage while the decoder is still running, and publishes rows as
+// stb_image finishes them (STBI_ROWS_DONE). Finished rows are uploaded in
+// bands through a staging buffer. Images are decoded top row first and
+// flipped into GL's bottom-up order while they are copied to the staging
+// buffer, so stb_image's own flip pass is never used here.
+
+// Shared between the decoding worker and the render thread
+struct DecodeProgress {
+    std::atomic<bool> headerReady { false };
+    int width = 0, height = 0, channels = 0; // valid once headerReady is set
+    std::atomic<const unsigned char*> pixels { nullptr };
+    std::atomic<int> channelsDone { 0 };
+    std::atomic<int> rowsDone { 0 };
+    std::atomic<bool> failed { false }; // pixels are gone, stop reading them
+};
+
+// Progress of the decode running on this thread, if anyone is listening
+inline DecodeProgress*& currentDecodeProgress()
+{
+    thread_local DecodeProgress* progress = nullptr;
+    return progress;
+}
+
+inline void reportDecodedRows(const unsigned char* pixels, int rows, int channels)
+{
+    DecodeProgress* progress = currentDecodeProgress();
+    if (!progress)
+        return;
+    progress->pixels.store(pixels, std::memory_order_relaxed);
+    progress->channelsDone.store(channels, std::memory_order_relaxed);
+    progress->rowsDone.store(rows, std::memory_order_release);
+}
+
+// Picked up by the stb_image implementation in main.cpp
+#define STBI_ROWS_DONE(pixels, rows, comp) reportDecodedRows(pixels, rows, comp)
+
+struct DecodedImage {
+    unsigned char* pixels = nullptr;
+    int width = 0, height = 0, channels = 0;
+    std::vector<unsigned char> encoded; // file bytes, kept for EvictPolicy::KeepEncoded
+};
+
+enum class TextureState { Unloaded, Loading, Ready, Failed };
+
+// What stays in CPU memory after a texture is evicted from the GPU
+enum class EvictPolicy {
+    Redecode,    // nothing, decode the file again
+    KeepEncoded, // the compressed file bytes
+    KeepDecoded  // the decoded pixels, restore is a plain upload
+};
+
+struct LazyTexture {
+    explicit LazyTexture(const char* path = nullptr) : path(path) {}
+
+    const char* path;
+    unsigned int id = 0;
+    TextureState state = TextureState::Unloaded;
+    std::future<DecodedImage> pending;
+    std::thread worker; // joined once pending is ready
+    std::shared_ptr<DecodeProgress> progress; // while Loading from an encoded image
+    int uploadedRows = 0;
+
+    // Pre-decoded copy in a mapped asset bundle, uploaded instead of decoding
+    const BundleEntry* bundled = nullptr;
+    const unsigned char* bundleData = nullptr;
+
+    // Residency bookkeeping (see texture_residency.h)
+    EvictPolicy policy = EvictPolicy::Redecode;
+    size_t gpuBytes = 0;
+    unsigned long lastVisibleFrame = 0;
+    std::vector<unsigned char> encoded;
+    DecodedImage cpuCopy;
+};
+
+// stb_image decoder contexts for the loader threads. Every decode runs on a
+// std::thread of its own that hands the image over through a promise and is
+// joined by pollTexture() once it has, so instead of one context per thread
+// each decode borrows a context for its duration and the next decode, on
+// whichever thread, reuses its scratch buffers. There are never more contexts than
+// decodes that ran at the same time.
+class DecoderContextPool {
+public:
+    ~DecoderContextPool()
+    {
+        for (stbi_decoder_context* ctx : idle)
+            stbi_decoder_context_free(ctx);
+    }
+
+    stbi_decoder_context* acquire()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (idle.empty())
+            return stbi_decoder_context_create();
+        stbi_decoder_context* ctx = idle.back();
+        idle.pop_back();
+        return ctx;
+    }
+
+    void release(stbi_decoder_context* ctx)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        idle.push_back(ctx);
+    }
+
+private:
+    std::mutex mutex;
+    std::vector<stbi_decoder_context*> idle;
+};
+
+inline DecoderContextPool& decoderContexts()
+{
+    static DecoderContextPool pool;
+    return pool;
+}
+
+// Padded mode (the default) has the decoder write RGBA, or R8/RG8 for grey
+// images, so every texel is a GL-friendly size. Native mode keeps what the
+// file has, including 3-byte RGB. Set before any texture is requested.
+inline bool padTextureChannels = true;
+
+// Channels the decoder is asked for, given the channels in the file
+inline int outputChannels(int fileChannels)
+{
+    if (!padTextureChannels)
+        return fileChannels;
+    return fileChannels <= 2 ? fileChannels : 4;
+}
+
+// Decode top row first, publishing the header and finished rows to progress
+inline DecodedImage decodeMemory(const std::vector<unsigned char>& encoded, DecodeProgress* progress)
+{
+    DecodedImage img;
+    if (encoded.empty())
+        return img;
+    int width, height, fileChannels;
+    if (!stbi_info_from_memory(encoded.data(), (int)encoded.size(), &width, &height, &fileChannels))
+        return img;
+    int channels = outputChannels(fileChannels);
+    if (progress) {
+        progress->width = width;
+        progress->height = height;
+        progress->channels = channels;
+        progress->headerReady.store(true, std::memory_order_release);
+    }
+
+    PROFILE_ZONE("decode");
+    stbi_decoder_context* ctx = decoderContexts().acquire();
+    stbi_set_decoder_context_thread(ctx);
+    stbi_set_flip_vertically_on_load_thread(0);
+    currentDecodeProgress() = progress;
+    img.pixels = stbi_load_from_memory(encoded.data(), (int)encoded.size(),
+                                       &img.width, &img.height, &fileChannels, channels);
+    img.channels = channels;
+    if (progress && !img.pixels)
+        progress->failed.store(true, std::memory_order_release);
+    currentDecodeProgress() = nullptr;
+    stbi_set_decoder_context_thread(nullptr);
+    decoderContexts().release(ctx);
+    return img;
+}
+
+inline DecodedImage decodeImage(const char* path, bool keepEncoded, DecodeProgress* progress = nullptr)
+{
+    std::vector<unsigned char> encoded;
+    {
+        PROFILE_ZONE("read file");
+        std::ifstream file(path, std::ios::binary);
+        encoded.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    DecodedImage img = decodeMemory(encoded, progress);
+    if (keepEncoded)
+        img.encoded = std::move(encoded);
+    return img;
+}
+
+inline DecodedImage decodeEncoded(const std::vector<unsigned char>* encoded, DecodeProgress* progress)
+{
+    return decodeMemory(*encoded, progress);
+}
+
+// Called on a worker thread after it has handed a decoded image over, so a
+// render loop sleeping in glfwWaitEvents can be woken (glfwPostEmptyEvent)
+inline void (*onTextureDecoded)() = nullptr;
+
+// Start decoding in the background; no-op if already requested.
+// Textures evicted earlier are restored from whatever CPU copy they kept.
+inline void requestTexture(LazyTexture& tex)
+{
+    if (tex.state != TextureState::Unloaded)
+        return;
+    tex.state = TextureState::Loading;
+    tex.uploadedRows = 0;
+    if (tex.bundled)
+        return; // nothing to decode, pollTexture uploads from the mapping
+    if (tex.cpuCopy.pixels) {
+        std::promise<DecodedImage> copy;
+        copy.set_value(tex.cpuCopy);
+        tex.pending = copy.get_future();
+        return;
+    }
+    tex.progress = std::make_shared<DecodeProgress>();
+    // The shared_ptr copy keeps the progress alive for the worker. The wake
+    // up has to follow set_value, which std::async cannot do, hence a thread
+    // of our own that pollTexture joins.
+    std::promise<DecodedImage> result;
+    tex.pending = result.get_future();
+    tex.worker = std::thread([result = std::move(result), progress = tex.progress,
+                              encoded = tex.encoded.empty() ? nullptr : &tex.encoded,
+                              path = tex.path, keepEncoded = tex.policy == EvictPolicy::KeepEncoded]() mutable {
+        PROFILE_THREAD("texture loader");
+        result.set_value(encoded ? decodeEncoded(encoded, progress.get())
+                                 : decodeImage(path, keepEncoded, progress.get()));
+        if (onTextureDecoded)
+            onTextureDecoded();
+    });
+}
+
+// Estimated GPU footprint including the mip chain; drivers store RGB8 as RGBA8
+inline size_t estimateTextureBytes(int width, int height, int channels)
+{
+    size_t texel = channels == 3 ? 4 : channels;
+    return (size_t)width * height * texel * 4 / 3;
+}
+
+// Rows per glTexSubImage2D call when uploading through the staging buffer
+const int uploadBandRows = 64;
+
+// Staged rows are padded to the default GL_UNPACK_ALIGNMENT of 4
+inline size_t uploadRowBytes(int width, int channels)
+{
+    return ((size_t)width * channels + 3) & ~(size_t)3;
+}
+
+struct TextureFormat {
+    GLint internalFormat;
+    GLenum format;
+    GLint swizzle[4];
+};
+
+// Grey images are stored as one or two channels and expanded by the sampler
+inline TextureFormat textureFormat(int channels)
+{
+    switch (channels) {
+    case 1:  return { GL_R8,    GL_RED,  { GL_RED, GL_RED, GL_RED, GL_ONE } };
+    case 2:  return { GL_RG8,   GL_RG,   { GL_RED, GL_RED, GL_RED, GL_GREEN } };
+    case 3:  return { GL_RGB8,  GL_RGB,  { GL_RED, GL_GREEN, GL_BLUE, GL_ONE } };
+    default: return { GL_RGBA8, GL_RGBA, { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA } };
+    }
+}
+
+inline void setTextureParameters(unsigned int id)
+{
+    glState().bindTexture(GL_TEXTURE_2D, id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+// Allocate level 0 without data; the rows follow through uploadRows
+inline void allocateTexture(unsigned int id, int width, int height, int channels)
+{
+    setTextureParameters(id);
+    TextureFormat format = textureFormat(channels);
+    glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, format.swizzle);
+    glTexImage2D(GL_TEXTURE_2D, 0, format.internalFormat, width, height, 0, format.format, GL_UNSIGNED_BYTE, nullptr);
+}
+
+// Pixel unpack buffer the bands are staged in, shared by all textures
+inline unsigned int stagingBuffer()
+{
+    static unsigned int pbo = 0;
+    if (!pbo)
+        glGenBuffers(1, &pbo);
+    return pbo;
+}
+
+// Upload rows [first, last) of a top-down image. Each band is copied into
+// the staging buffer bottom row first, which is the flip to GL's origin.
+inline void uploadRows(unsigned int id, const unsigned char* pixels, int width, int height, int channels,
+                       int first, int last)
+{
+    size_t rowBytes = (size_t)width * channels, stride = uploadRowBytes(width, channels);
+    GLenum format = textureFormat(channels).format;
+    glState().bindTexture(GL_TEXTURE_2D, id);
+    glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer());
+    for (int band = first; band < last; band += uploadBandRows) {
+        int end = std::min(last, band + uploadBandRows);
+        size_t bytes = stride * (end - band);
+        // Orphan the previous band instead of waiting for its transfer
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+        unsigned char* dst = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+                                                              GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (!dst)
+            break;
+        for (int row = band; row < end; ++row)
+            memcpy(dst + (end - 1 - row) * stride, pixels + row * rowBytes, rowBytes);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, height - end, width, end - band, format, GL_UNSIGNED_BYTE, nullptr);
+    }
+    glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+inline void uploadTexture(unsigned int id, const DecodedImage& img)
+{
+    allocateTexture(id, img.width, img.height, img.channels);
+    uploadRows(id, img.pixels, img.width, img.height, img.channels, 0, img.height);
+    glGenerateMipmap(GL_TEXTURE_2D);
+}
+
+// Bundle textures carry their mip chain already in GL row order, so every
+// level goes to the driver straight from the mapped pages
+inline void uploadBundleTexture(unsigned int id, const BundleEntry& entry, const unsigned char* data)
+{
+    setTextureParameters(id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, entry.levels - 1);
+    for (uint32_t level = 0; level < entry.levels; ++level) {
+        int width = std::max(1u, entry.width >> level), height = std::max(1u, entry.height >> level);
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+        data += bundleLevelSize(entry, level);
+    }
+}
+
+// Render thread: allocate storage once the header is known and upload the
+// complete bands the decoder has finished since the last call
+inline void streamTexture(LazyTexture& tex)
+{
+    DecodeProgress* progress = tex.progress.get();
+    if (!progress || !progress->headerReady.load(std::memory_order_acquire) ||
+        progress->failed.load(std::memory_order_acquire))
+        return;
+    if (!tex.id) {
+        glGenTextures(1, &tex.id);
+        allocateTexture(tex.id, progress->width, progress->height, progress->channels);
+    }
+    int rows = progress->rowsDone.load(std::memory_order_acquire);
+    if (progress->channelsDone.load(std::memory_order_relaxed) != progress->channels)
+        return; // output layout differs from the header (e.g. CMYK JPEG), upload at the end
+    int last = tex.uploadedRows + (rows - tex.uploadedRows) / uploadBandRows * uploadBandRows;
+    if (last > tex.uploadedRows) {
+        PROFILE_ZONE("upload rows");
+        uploadRows(tex.id, progress->pixels.load(std::memory_order_relaxed), progress->width, progress->height,
+                   progress->channels, tex.uploadedRows, last);
+        tex.uploadedRows = last;
+    }
+}
+
+// Called once per frame on the GL thread; returns true when the texture
+// became ready (or failed) during this call
+inline bool pollTexture(LazyTexture& tex)
+{
+    if (tex.state != TextureState::Loading)
+        return false;
+    if (tex.bundled) {
+        PROFILE_ZONE("upload bundled");
+        glGenTextures(1, &tex.id);
+        uploadBundleTexture(tex.id, *tex.bundled, tex.bundleData);
+        tex.gpuBytes = estimateTextureBytes(tex.bundled->width, tex.bundled->height, 4);
+        tex.state = TextureState::Ready;
+        return true;
+    }
+    streamTexture(tex);
+    if (tex.pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return false;
+
+    PROFILE_ZONE("finish texture");
+    DecodedImage img = tex.pending.get();
+    if (tex.worker.joinable())
+        tex.worker.join();
+    DecodeProgress* progress = tex.progress.get();
+    if (img.pixels) {
+        // Rows streamed so far are only valid if they came from this buffer
+        bool streamed = tex.id && progress && progress->pixels.load() == img.pixels &&
+                        progress->width == img.width && progress->height == img.height &&
+                        progress->channels == img.channels;
+        if (!streamed) {
+            if (!tex.id)
+                glGenTextures(1, &tex.id);
+            allocateTexture(tex.id, img.width, img.height, img.channels);
+            tex.uploadedRows = 0;
+        }
+        uploadRows(tex.id, img.pixels, img.width, img.height, img.channels, tex.uploadedRows, img.height);
+        glState().bindTexture(GL_TEXTURE_2D, tex.id);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        tex.gpuBytes = estimateTextureBytes(img.width, img.height, img.channels);
+        tex.state = TextureState::Ready;
+    } else {
+        std::cerr << "Failed to load " << tex.path << "\n";
+        if (tex.id) {
+            glState().forgetTexture(tex.id);
+            glDeleteTextures(1, &tex.id);
+        }
+        tex.id = 0;
+        tex.state = TextureState::Failed;
+    }
+    tex.progress.reset();
+    tex.uploadedRows = 0;
+    if (!img.encoded.empty())
+        tex.encoded = std::move(img.encoded);
+    if (tex.policy == EvictPolicy::KeepDecoded && img.pixels) {
+        img.encoded.clear();
+        tex.cpuCopy = img;
+    } else {
+        stbi_image_free(img.pixels);
+    }
+    return true;
+}
+
+// Drop the GPU copy; the texture goes back to Unloaded and is restored by
+// the next requestTexture call
+inline void evictTexture(LazyTexture& tex)
+{
+    if (tex.id) {
+        glState().forgetTexture(tex.id);
+        glDeleteTextures(1, &tex.id);
+    }
+    tex.id = 0;
+    tex.state = TextureState::Unloaded;
+}
+
+inline void destroyTexture(LazyTexture& tex)
+{
+    if (tex.pending.valid()) {
+        DecodedImage img = tex.pending.get();
+        if (img.pixels != tex.cpuCopy.pixels)
+            stbi_image_free(img.pixels);
+    }
+    if (tex.worker.joinable())
+        tex.worker.join();
+    evictTexture(tex);
+    stbi_image_free(tex.cpuCopy.pixels);
+    tex.cpuCopy = DecodedImage();
+    tex.encoded.clear();
+    tex.gpuBytes = 0;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <algorithm>
+#include <vector>
+#include "texture_loader.h"
+
+// Keeps the GPU-resident textures under a byte budget. Textures that have
+// not been visible for the longest time are evicted first; a texture drawn
+// in the current frame is never evicted. Evicted textures keep the CPU copy
+// selected by their EvictPolicy and are restored asynchronously through
+// requestTexture when their shape is shown again.
+struct TextureResidency {
+    size_t budgetBytes;
+    unsigned long frame = 1;
+    std::vector<LazyTexture*> textures;
+
+    explicit TextureResidency(size_t budget) : budgetBytes(budget) {}
+
+    void track(LazyTexture& tex) { textures.push_back(&tex); }
+
+    // Call for every texture that is drawn this frame
+    void markVisible(LazyTexture& tex)
+    {
+        tex.lastVisibleFrame = frame;
+        requestTexture(tex);
+    }
+
+    size_t residentBytes() const
+    {
+        size_t total = 0;
+        for (const LazyTexture* tex : textures)
+            if (tex->state == TextureState::Ready)
+                total += tex->gpuBytes;
+        return total;
+    }
+
+    // Evict least-recently-visible textures until the budget is met
+    void endFrame()
+    {
+        size_t resident = residentBytes();
+        if (resident > budgetBytes) {
+            std::vector<LazyTexture*> candidates;
+            for (LazyTexture* tex : textures)
+                if (tex->state == TextureState::Ready && tex->lastVisibleFrame != frame)
+                    candidates.push_back(tex);
+            std::sort(candidates.begin(), candidates.end(),
+                      [](const LazyTexture* a, const LazyTexture* b) {
+                          return a->lastVisibleFrame < b->lastVisibleFrame;
+                      });
+            for (LazyTexture* tex : candidates) {
+                if (resident <= budgetBytes)
+                    break;
+                resident -= tex->gpuBytes;
+                evictTexture(*tex);
+            }
+        }
+        ++frame;
+    }
+};
@@ -0,0 +1,235 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "texture_loader.h"
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// Hot reload of texture files. A background thread watches the directories
+// of the tracked textures with inotify, waits until a file has been quiet for
+// a short while (so a burst of saves is decoded once), decodes it and leaves
+// the result in a mailbox. The render thread picks it up at a frame boundary,
+// uploads into a fresh texture object and retires the old one once the GPU
+// is done with it. On platforms without inotify the watcher does nothing.
+class TextureWatcher {
+public:
+    // Quiet period after the last write before a file is decoded
+    std::chrono::milliseconds settleTime { 150 };
+
+    ~TextureWatcher() { stop(); }
+
+    void track(LazyTexture& tex) { textures.push_back(&tex); }
+
+    void start()
+    {
+#ifdef __linux__
+        fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd < 0) {
+            std::cerr << "inotify unavailable, texture hot reload disabled\n";
+            return;
+        }
+        // One watch per directory however its textures spell it: inotify
+        // hands out one descriptor for "." and "./", so keying by the
+        // string would let one texture's entry replace another's
+        std::map<std::string, int> dirWatches; // canonical path -> watch
+        for (LazyTexture* tex : textures) {
+            std::string path = tex->path;
+            size_t slash = path.rfind('/');
+            std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+            char* canonical = realpath(dir.c_str(), nullptr);
+            if (!canonical)
+                continue;
+            auto it = dirWatches.find(canonical);
+            if (it == dirWatches.end())
+                it = dirWatches.emplace(canonical, inotify_add_watch(fd, canonical, IN_CLOSE_WRITE | IN_MOVED_TO)).first;
+            std::free(canonical);
+            if (it->second >= 0)
+                watched[it->second].push_back({ tex, slash == std::string::npos ? path : path.substr(slash + 1) });
+        }
+        running = true;
+        worker = std::thread(&TextureWatcher::run, this);
+#endif
+    }
+
+    void stop()
+    {
+        running = false;
+        if (worker.joinable())
+            worker.join();
+#ifdef __linux__
+        if (fd >= 0)
+            close(fd);
+        fd = -1;
+#endif
+        std::lock_guard<std::mutex> lock(mailboxMutex);
+        for (auto& entry : mailbox)
+            stbi_image_free(entry.second.pixels);
+        mailbox.clear();
+    }
+
+    // Render thread, once per frame: swap in reloaded textures and delete
+    // the ones retired in earlier frames that the GPU has finished with.
+    // Returns true if any texture changed.
+    bool applyReloads()
+    {
+        bool changed = false;
+        std::map<std::string, DecodedImage> ready;
+        {
+            std::lock_guard<std::mutex> lock(mailboxMutex);
+            ready.swap(mailbox);
+        }
+        for (auto& entry : ready) {
+            LazyTexture* tex = find(entry.first);
+            DecodedImage& img = entry.second;
+            if (tex && tex->state == TextureState::Loading) {
+                // Wait until the in-flight load lands, then replace it
+                std::lock_guard<std::mutex> lock(mailboxMutex);
+                if (!mailbox.emplace(entry.first, img).second)
+                    stbi_image_free(img.pixels); // superseded by a newer save
+                continue;
+            }
+            if (tex) {
+                // Cached CPU copies are stale now
+                stbi_image_free(tex->cpuCopy.pixels);
+                tex->cpuCopy = DecodedImage();
+                tex->encoded.clear();
+                tex->bundled = nullptr; // the loose file is newer than the bundle
+            }
+            // A texture that failed to load gets the fixed file like a
+            // resident one gets the new version
+            if (tex && (tex->state == TextureState::Ready || tex->state == TextureState::Failed)) {
+                unsigned int fresh;
+                glGenTextures(1, &fresh);
+                uploadTexture(fresh, img);
+                if (tex->id)
+                    retire(tex->id);
+                tex->id = fresh;
+                tex->state = TextureState::Ready;
+                tex->gpuBytes = estimateTextureBytes(img.width, img.height, img.channels);
+                if (tex->policy == EvictPolicy::KeepDecoded) {
+                    tex->cpuCopy = img;
+                    img.pixels = nullptr;
+                }
+                changed = true;
+            }
+            // Textures that are not resident pick the new file up on their next load
+            stbi_image_free(img.pixels);
+        }
+        collectRetired();
+        return changed;
+    }
+
+private:
+    struct Retired {
+        unsigned int id;
+        GLsync fence;
+    };
+
+    // A tracked texture and its file name within the watched directory
+    struct WatchedFile {
+        LazyTexture* tex;
+        std::string name;
+    };
+
+    std::vector<LazyTexture*> textures;
+    std::map<int, std::vector<WatchedFile>> watched; // by inotify watch descriptor
+    std::map<std::string, DecodedImage> mailbox;
+    std::mutex mailboxMutex;
+    std::vector<Retired> retired;
+    std::atomic<bool> running { false };
+    std::thread worker;
+    int fd = -1;
+
+    LazyTexture* find(const std::string& path)
+    {
+        for (LazyTexture* tex : textures)
+            if (path == tex->path)
+                return tex;
+        return nullptr;
+    }
+
+    void retire(unsigned int id)
+    {
+        retired.push_back({ id, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) });
+    }
+
+    void collectRetired()
+    {
+        for (size_t i = 0; i < retired.size();) {
+            GLenum status = glClientWaitSync(retired[i].fence, 0, 0);
+            if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+                glDeleteSync(retired[i].fence);
+                glState().forgetTexture(retired[i].id);
+                glDeleteTextures(1, &retired[i].id);
+                retired[i] = retired.back();
+                retired.pop_back();
+            } else {
+                ++i;
+            }
+        }
+    }
+
+#ifdef __linux__
+    void run()
+    {
+        PROFILE_THREAD("texture watcher");
+        using Clock = std::chrono::steady_clock;
+        std::map<std::string, Clock::time_point> dirty; // path -> last write
+        alignas(inotify_event) char buf[4096];
+
+        while (running) {
+            pollfd pfd { fd, POLLIN, 0 };
+            poll(&pfd, 1, 50);
+
+            ssize_t len;
+            while ((len = read(fd, buf, sizeof(buf))) > 0) {
+                for (char* p = buf; p < buf + len;) {
+                    const inotify_event* ev = reinterpret_cast<const inotify_event*>(p);
+                    auto files = watched.find(ev->wd);
+                    if (ev->len && files != watched.end())
+                        for (const WatchedFile& file : files->second)
+                            if (file.name == ev->name)
+                                dirty[file.tex->path] = Clock::now();
+                    p += sizeof(inotify_event) + ev->len;
+                }
+            }
+
+            // Decode files whose last write is older than the settle time
+            for (auto it = dirty.begin(); it != dirty.end();) {
+                if (Clock::now() - it->second < settleTime) {
+                    ++it;
+                    continue;
+                }
+                DecodedImage img = decodeImage(it->first.c_str(), false);
+                if (img.pixels) {
+                    std::lock_guard<std::mutex> lock(mailboxMutex);
+                    auto old = mailbox.find(it->first);
+                    if (old != mailbox.end()) {
+                        stbi_image_free(old->second.pixels);
+                        old->second = img;
+                    } else {
+                        mailbox.emplace(it->first, img);
+                    }
+                    if (onTextureDecoded)
+                        onTextureDecoded();
+                } else {
+                    std::cerr << "Hot reload: failed to decode " << it->first << "\n";
+                }
+                it = dirty.erase(it);
+            }
+        }
+    }
+#else
+    void run() {}
+#endif
+};
@@ -0,0 +1,573 @@
+#pragma once
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "../common/cpu_profiler.h"
+#include "../common/gl_state.h"
+#include "../common/shader_manager.h"
+#include "mipmap.h"
+#include "stb_image.h"
+
+// Virtual texturing for images too large to keep in memory.
+//
+// A one-time pass splits the source into a mip pyramid of fixed-size tiles
+// stored as raw RGBA files next to it. At runtime the image is drawn from a
+// fixed-size physical cache texture: a low-resolution feedback pass records
+// which tile each pixel wants, a streaming thread reads the missing tiles
+// from disk and the least recently used cache slots are recycled for them.
+// A page table texture maps every virtual tile to the best resident tile,
+// falling back to coarser levels until the wanted one arrives. GPU and CPU
+// memory stay the same no matter how large the source is.
+
+// Tiles carry a one texel border so bilinear filtering does not bleed
+// across slots in the cache texture
+inline std::string tilePath(const std::string& dir, int level, int x, int y)
+{
+    return dir + "/" + std::to_string(level) + "_" + std::to_string(x) + "_" + std::to_string(y) + ".rgba";
+}
+
+inline void writeTiles(const unsigned char* px, int w, int h, int level,
+                       const std::string& dir, int tileSize)
+{
+    int slot = tileSize + 2;
+    std::vector<unsigned char> tile((size_t)slot * slot * 4);
+    for (int ty = 0; ty * tileSize < h; ++ty) {
+        for (int tx = 0; tx * tileSize < w; ++tx) {
+            for (int sy = 0; sy < slot; ++sy) {
+                int y = std::clamp(ty * tileSize + sy - 1, 0, h - 1);
+                for (int sx = 0; sx < slot; ++sx) {
+                    int x = std::clamp(tx * tileSize + sx - 1, 0, w - 1);
+                    std::copy_n(px + ((size_t)y * w + x) * 4, 4, &tile[((size_t)sy * slot + sx) * 4]);
+                }
+            }
+            std::ofstream out(tilePath(dir, level, tx, ty), std::ios::binary);
+            out.write(reinterpret_cast<const char*>(tile.data()), tile.size());
+        }
+    }
+}
+
+// One-time split of the source image into <dir>/<level>_<x>_<y>.rgba tiles
+// plus an info file. stb_image can only decode whole images, so this pass
+// (and only this pass) holds the full source in memory.
+inline bool buildTileCache(const std::string& source, const std::string& dir, int tileSize)
+{
+    int w, h, n;
+    unsigned char* src = stbi_load(source.c_str(), &w, &h, &n, 4);
+    if (!src) {
+        std::cerr << "Failed to load " << source << "\n";
+        return false;
+    }
+    mkdir(dir.c_str(), 0755);
+    std::cout << "Building tile cache for " << source << " (" << w << "x" << h << ")\n";
+
+    writeTiles(src, w, h, 0, dir, tileSize);
+    std::vector<unsigned char> level;
+    int levels = 1, lw = w, lh = h;
+    while (lw > tileSize || lh > tileSize) {
+        int nw, nh;
+        level = downsample(levels == 1 ? src : level.data(), lw, lh, nw, nh);
+        if (levels == 1) {
+            stbi_image_free(src);
+            src = nullptr;
+        }
+        lw = nw;
+        lh = nh;
+        writeTiles(level.data(), lw, lh, levels++, dir, tileSize);
+    }
+    stbi_image_free(src);
+
+    std::ofstream info(dir + "/info.txt");
+    info << w << " " << h << " " << tileSize << " " << levels << "\n";
+    return bool(info);
+}
+
+class VirtualTexture {
+public:
+    // View: center of the visible region in texture space and its extent
+    float centerX = 0.5f, centerY = 0.5f, extent = 1.0f;
+
+    // Cache is cacheSlots x cacheSlots tiles; the feedback buffer is the
+    // window size divided by feedbackDivisor
+    int cacheSlots = 8;
+    int feedbackDivisor = 8;
+    int uploadsPerFrame = 8;
+
+    ~VirtualTexture() { stopStreaming(); }
+
+    // The shaders are submitted to `shaders` first and picked up at the end,
+    // so they compile while the caches are set up
+    bool init(const std::string& source, int windowWidth, int windowHeight, ShaderManager& shaders)
+    {
+        int displayShader = shaders.submit("virtual texture", vertexSource(), displayFragmentSource());
+        int feedbackShader = shaders.submit("virtual texture feedback", vertexSource(), feedbackFragmentSource());
+        dir = source + ".tiles";
+        std::ifstream info(dir + "/info.txt");
+        if (!(info >> width >> height >> tileSize >> levels)) {
+            if (!buildTileCache(source, dir, 128))
+                return false;
+            info = std::ifstream(dir + "/info.txt");
+            info >> width >> height >> tileSize >> levels;
+        }
+        slotSize = tileSize + 2;
+
+        // Physical tile cache
+        glGenTextures(1, &cacheTex);
+        glState().bindTexture(GL_TEXTURE_2D, cacheTex);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, cacheSlots * slotSize, cacheSlots * slotSize, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        slots.assign(cacheSlots * cacheSlots, Slot());
+
+        // Page table: one RGBA8 texel per tile per level (slot x, slot y,
+        // resident level). The base size is a power of two so that every
+        // level's tile grid fits in the matching mip.
+        pageTableSize = 1;
+        while (pageTableSize * tileSize < std::max(width, height))
+            pageTableSize *= 2;
+        glGenTextures(1, &pageTableTex);
+        glState().bindTexture(GL_TEXTURE_2D, pageTableTex);
+        pageTable.resize(levels);
+        for (int l = 0; l < levels; ++l) {
+            int size = std::max(1, pageTableSize >> l);
+            pageTable[l].assign((size_t)size * size * 4, 0);
+            glTexImage2D(GL_TEXTURE_2D, l, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        // Low-resolution feedback target, read back through two PBOs so the
+        // CPU always reads the previous frame's results
+        glGenRenderbuffers(1, &feedbackRbo);
+        glGenBuffers(2, feedbackPbo);
+        resize(windowWidth, windowHeight);
+        glGenFramebuffers(1, &feedbackFbo);
+        glState().bindFramebuffer(GL_FRAMEBUFFER, feedbackFbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, feedbackRbo);
+        glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        // Full-window quad
+        float quad[] = { -1, -1,  1, -1,  1, 1,  -1, -1,  1, 1,  -1, 1 };
+        glGenVertexArrays(1, &vao);
+        glGenBuffers(1, &vbo);
+        glState().bindVertexArray(vao);
+        glState().bindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+
+        // The coarsest level is a single tile and stays pinned, so every
+        // page table entry has something to fall back to
+        std::vector<unsigned char> top;
+        if (!readTile(key(levels - 1, 0, 0), top)) {
+            std::cerr << "Tile cache " << dir << " is incomplete\n";
+            return false;
+        }
+        place(key(levels - 1, 0, 0), top, 0);
+        slots[0].pinned = true;
+        rebuildPageTable();
+
+        displayProg = shaders.program(displayShader);
+        feedbackProg = shaders.program(feedbackShader);
+        streamer = std::thread(&VirtualTexture::stream, this);
+        return true;
+    }
+
+    // After the window's framebuffer changed size: the feedback target and
+    // its PBOs follow it, and a readback still in flight is dropped since
+    // it no longer fits them
+    void resize(int windowWidth, int windowHeight)
+    {
+        if (!feedbackRbo)
+            return;
+        feedbackWidth = std::max(1, windowWidth / feedbackDivisor);
+        feedbackHeight = std::max(1, windowHeight / feedbackDivisor);
+        glBindRenderbuffer(GL_RENDERBUFFER, feedbackRbo);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, feedbackWidth, feedbackHeight);
+        for (unsigned int pbo : feedbackPbo) {
+            glState().bindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+            glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)feedbackWidth * feedbackHeight * 4, nullptr, GL_STREAM_READ);
+        }
+        glState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        feedbackPending = false;
+    }
+
+    void zoom(float steps)
+    {
+        extent = std::clamp(extent * std::pow(0.9f, steps), 1e-4f, 2.0f);
+    }
+
+    void pan(float dx, float dy)
+    {
+        centerX += dx * extent;
+        centerY += dy * extent;
+    }
+
+    // Once per frame before render(): consume last frame's feedback, request
+    // missing tiles and upload the ones the streaming thread finished
+    void update()
+    {
+        ++frame;
+        readFeedback();
+
+        std::vector<std::pair<uint64_t, std::vector<unsigned char>>> ready;
+        {
+            std::lock_guard<std::mutex> lock(streamMutex);
+            size_t count = std::min(loaded.size(), (size_t)uploadsPerFrame);
+            ready.assign(std::make_move_iterator(loaded.begin()), std::make_move_iterator(loaded.begin() + count));
+            loaded.erase(loaded.begin(), loaded.begin() + count);
+        }
+        bool dirty = false;
+        for (auto& tile : ready) {
+            inFlight.erase(tile.first);
+            int slot = victimSlot();
+            if (slot < 0)
+                continue; // every slot is in use this frame; ask again later
+            place(tile.first, tile.second, slot);
+            dirty = true;
+        }
+        if (dirty)
+            rebuildPageTable();
+    }
+
+    void render(int windowWidth, int windowHeight)
+    {
+        glState().activeTexture(GL_TEXTURE1);
+        glState().bindTexture(GL_TEXTURE_2D, pageTableTex);
+        glState().activeTexture(GL_TEXTURE0);
+        glState().bindTexture(GL_TEXTURE_2D, cacheTex);
+        glState().bindVertexArray(vao);
+
+        // Feedback pass into the small target, read back asynchronously
+        glState().bindFramebuffer(GL_FRAMEBUFFER, feedbackFbo);
+        glViewport(0, 0, feedbackWidth, feedbackHeight);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        setUniforms(feedbackProg, -std::log2((float)feedbackDivisor));
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+        glState().bindBuffer(GL_PIXEL_PACK_BUFFER, feedbackPbo[frame % 2]);
+        glReadPixels(0, 0, feedbackWidth, feedbackHeight, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        feedbackPending = true;
+        glState().bindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, windowWidth, windowHeight);
+
+        setUniforms(displayProg, 0.0f);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
+
+    void destroy()
+    {
+        stopStreaming();
+        glState().forgetTexture(cacheTex);
+        glState().forgetTexture(pageTableTex);
+        glState().forgetBuffer(feedbackPbo[0]);
+        glState().forgetBuffer(feedbackPbo[1]);
+        glState().forgetBuffer(vbo);
+        glState().forgetVertexArray(vao);
+        glState().forgetProgram(displayProg);
+        glState().forgetProgram(feedbackProg);
+        glState().forgetFramebuffer(feedbackFbo);
+        glDeleteTextures(1, &cacheTex);
+        glDeleteTextures(1, &pageTableTex);
+        glDeleteFramebuffers(1, &feedbackFbo);
+        glDeleteRenderbuffers(1, &feedbackRbo);
+        glDeleteBuffers(2, feedbackPbo);
+        glDeleteVertexArrays(1, &vao);
+        glDeleteBuffers(1, &vbo);
+        glDeleteProgram(displayProg);
+        glDeleteProgram(feedbackProg);
+    }
+
+private:
+    struct Slot {
+        uint64_t key = ~0ull;
+        unsigned long lastUsed = 0;
+        bool pinned = false;
+    };
+
+    std::string dir;
+    int width = 0, height = 0, tileSize = 0, slotSize = 0, levels = 0;
+    int pageTableSize = 1;
+    int feedbackWidth = 0, feedbackHeight = 0;
+    unsigned long frame = 0;
+    bool feedbackPending = false;
+
+    unsigned int cacheTex = 0, pageTableTex = 0;
+    unsigned int feedbackFbo = 0, feedbackRbo = 0, feedbackPbo[2] = {};
+    unsigned int vao = 0, vbo = 0, displayProg = 0, feedbackProg = 0;
+
+    std::vector<Slot> slots;
+    std::unordered_map<uint64_t, int> resident; // tile -> slot
+    std::unordered_set<uint64_t> inFlight;
+    std::vector<std::vector<unsigned char>> pageTable;
+
+    // Streaming thread state
+    std::thread streamer;
+    std::mutex streamMutex;
+    std::condition_variable streamCv;
+    std::deque<uint64_t> requests;
+    std::vector<std::pair<uint64_t, std::vector<unsigned char>>> loaded;
+    bool stopping = false;
+
+    static uint64_t key(int level, int x, int y)
+    {
+        return ((uint64_t)level << 48) | ((uint64_t)y << 24) | (uint64_t)x;
+    }
+    static int keyLevel(uint64_t k) { return int(k >> 48); }
+    static int keyY(uint64_t k) { return int((k >> 24) & 0xFFFFFF); }
+    static int keyX(uint64_t k) { return int(k & 0xFFFFFF); }
+
+    int levelWidth(int level) const { return std::max(1, width >> level); }
+    int levelHeight(int level) const { return std::max(1, height >> level); }
+    int tilesX(int level) const { return (levelWidth(level) + tileSize - 1) / tileSize; }
+    int tilesY(int level) const { return (levelHeight(level) + tileSize - 1) / tileSize; }
+
+    bool readTile(uint64_t k, std::vector<unsigned char>& out) const
+    {
+        std::ifstream in(tilePath(dir, keyLevel(k), keyX(k), keyY(k)), std::ios::binary);
+        out.resize((size_t)slotSize * slotSize * 4);
+        return bool(in.read(reinterpret_cast<char*>(out.data()), out.size()));
+    }
+
+    void stream()
+    {
+        PROFILE_THREAD("tile streamer");
+        std::unique_lock<std::mutex> lock(streamMutex);
+        while (true) {
+            streamCv.wait(lock, [this] { return stopping || !requests.empty(); });
+            if (stopping)
+                return;
+            uint64_t k = requests.front();
+            requests.pop_front();
+            lock.unlock();
+            std::vector<unsigned char> pixels;
+            bool ok;
+            {
+                PROFILE_ZONE("read tile");
+                ok = readTile(k, pixels);
+            }
+            lock.lock();
+            if (ok)
+                loaded.emplace_back(k, std::move(pixels));
+        }
+    }
+
+    void stopStreaming()
+    {
+        {
+            std::lock_guard<std::mutex> lock(streamMutex);
+            stopping = true;
+        }
+        streamCv.notify_all();
+        if (streamer.joinable())
+            streamer.join();
+    }
+
+    void request(uint64_t k)
+    {
+        if (resident.count(k) || !inFlight.insert(k).second)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(streamMutex);
+            requests.push_back(k);
+        }
+        streamCv.notify_one();
+    }
+
+    void readFeedback()
+    {
+        if (!feedbackPending)
+            return;
+        size_t size = (size_t)feedbackWidth * feedbackHeight * 4;
+        glState().bindBuffer(GL_PIXEL_PACK_BUFFER, feedbackPbo[(frame - 1) % 2]);
+        const unsigned char* px = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+        if (px) {
+            std::unordered_set<uint64_t> wanted;
+            for (size_t i = 0; i < size; i += 4) {
+                if (!px[i + 3])
+                    continue;
+                int level = px[i + 3] - 1;
+                int x = px[i] | ((px[i + 2] & 15) << 8);
+                int y = px[i + 1] | ((px[i + 2] >> 4) << 8);
+                wanted.insert(key(level, x, y));
+            }
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            for (uint64_t k : wanted) {
+                auto it = resident.find(k);
+                if (it != resident.end()) {
+                    slots[it->second].lastUsed = frame;
+                    continue;
+                }
+                request(k);
+                // The parent makes a closer fallback while the tile streams in
+                int level = keyLevel(k);
+                if (level + 1 < levels)
+                    request(key(level + 1, keyX(k) / 2, keyY(k) / 2));
+            }
+        }
+        glState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    // Least recently used unpinned slot not needed by the current frame
+    int victimSlot() const
+    {
+        int best = -1;
+        for (int i = 0; i < (int)slots.size(); ++i) {
+            if (slots[i].pinned || (slots[i].key != ~0ull && slots[i].lastUsed >= frame))
+                continue;
+            if (best < 0 || slots[i].lastUsed < slots[best].lastUsed)
+                best = i;
+        }
+        return best;
+    }
+
+    void place(uint64_t k, const std::vector<unsigned char>& pixels, int slot)
+    {
+        if (slots[slot].key != ~0ull)
+            resident.erase(slots[slot].key);
+        slots[slot].key = k;
+        slots[slot].lastUsed = frame;
+        resident[k] = slot;
+        glState().bindTexture(GL_TEXTURE_2D, cacheTex);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, (slot % cacheSlots) * slotSize, (slot / cacheSlots) * slotSize,
+                        slotSize, slotSize, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    }
+
+    // Every entry points at its own tile when resident, otherwise at
+    // whatever its parent entry points at
+    void rebuildPageTable()
+    {
+        glState().bindTexture(GL_TEXTURE_2D, pageTableTex);
+        for (int l = levels - 1; l >= 0; --l) {
+            int size = std::max(1, pageTableSize >> l);
+            int parentSize = std::max(1, pageTableSize >> (l + 1));
+            for (int y = 0; y < tilesY(l); ++y) {
+                for (int x = 0; x < tilesX(l); ++x) {
+                    unsigned char* entry = &pageTable[l][((size_t)y * size + x) * 4];
+                    auto it = resident.find(key(l, x, y));
+                    if (it != resident.end()) {
+                        entry[0] = (unsigned char)(it->second % cacheSlots);
+                        entry[1] = (unsigned char)(it->second / cacheSlots);
+                        entry[2] = (unsigned char)l;
+                        entry[3] = 255;
+                    } else if (l + 1 < levels) {
+                        std::copy_n(&pageTable[l + 1][((size_t)(y / 2) * parentSize + x / 2) * 4], 4, entry);
+                    }
+                }
+            }
+            glTexSubImage2D(GL_TEXTURE_2D, l, 0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, pageTable[l].data());
+        }
+    }
+
+    void setUniforms(unsigned int prog, float lodBias)
+    {
+        glState().useProgram(prog);
+        glUniform1i(glGetUniformLocation(prog, "uCache"), 0);
+        glUniform1i(glGetUniformLocation(prog, "uPageTable"), 1);
+        glUniform2i(glGetUniformLocation(prog, "uVirtualSize"), width, height);
+        glUniform1i(glGetUniformLocation(prog, "uTileSize"), tileSize);
+        glUniform1i(glGetUniformLocation(prog, "uMaxLevel"), levels - 1);
+        glUniform1f(glGetUniformLocation(prog, "uLodBias"), lodBias);
+        glUniform1f(glGetUniformLocation(prog, "uSlotSize"), (float)slotSize);
+        glUniform3f(glGetUniformLocation(prog, "uView"), centerX, centerY, extent);
+    }
+
+    static const char* vertexSource()
+    {
+        return R"(#version 330 core
+layout(location = 0) in vec2 aPos;
+uniform vec3 uView; // center.xy, extent
+out vec2 TexCoords;
+void main()
+{
+    gl_Position = vec4(aPos, 0.0, 1.0);
+    TexCoords = uView.xy + aPos * 0.5 * uView.z;
+})";
+    }
+
+    static std::string commonSource()
+    {
+        return R"(#version 330 core
+in vec2 TexCoords;
+out vec4 FragColor;
+uniform sampler2D uPageTable;
+uniform ivec2 uVirtualSize;
+uniform int uTileSize;
+uniform int uMaxLevel;
+uniform float uLodBias;
+
+ivec2 levelSize(int level) { return max(uVirtualSize >> level, ivec2(1)); }
+
+int desiredLevel(vec2 uv)
+{
+    vec2 px = uv * vec2(uVirtualSize);
+    vec2 dx = dFdx(px), dy = dFdy(px);
+    float lod = 0.5 * log2(max(dot(dx, dx), dot(dy, dy))) + uLodBias;
+    return clamp(int(floor(lod)), 0, uMaxLevel);
+}
+
+ivec2 tileAt(vec2 uv, int level)
+{
+    ivec2 size = levelSize(level);
+    ivec2 tile = ivec2(floor(uv * vec2(size) / float(uTileSize)));
+    return clamp(tile, ivec2(0), (size - 1) / uTileSize);
+}
+
+bool outside(vec2 uv) { return any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0))); }
+)";
+    }
+
+    static std::string displayFragmentSource()
+    {
+        return commonSource() + R"(
+uniform sampler2D uCache;
+uniform float uSlotSize;
+void main()
+{
+    int level = desiredLevel(TexCoords);
+    if (outside(TexCoords)) {
+        FragColor = vec4(0.1, 0.1, 0.1, 1.0);
+        return;
+    }
+    vec4 entry = texelFetch(uPageTable, tileAt(TexCoords, level), level) * 255.0 + 0.5;
+    int mapped = int(entry.b);
+    vec2 local = TexCoords * vec2(levelSize(mapped)) / float(uTileSize) - vec2(tileAt(TexCoords, mapped));
+    vec2 texel = floor(entry.rg) * uSlotSize + 1.0 + local * float(uTileSize);
+    FragColor = textureLod(uCache, texel / vec2(textureSize(uCache, 0)), 0.0);
+})";
+    }
+
+    static std::string feedbackFragmentSource()
+    {
+        return commonSource() + R"(
+void main()
+{
+    int level = desiredLevel(TexCoords);
+    if (outside(TexCoords)) {
+        FragColor = vec4(0.0);
+        return;
+    }
+    ivec2 t = tileAt(TexCoords, level);
+    FragColor = vec4(t.x & 255, t.y & 255, ((t.x >> 8) & 15) | (((t.y >> 8) & 15) << 4), level + 1) / 255.0;
+})";
+    }
+
+};
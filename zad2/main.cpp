@@ -3,20 +3,39 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <string>
+#include "../common/app_window.h"
+#include "../common/cpu_profiler.h"
+#include "../common/dynamic_resolution.h"
+#include "../common/frame_capture.h"
+#include "../common/frame_pacer.h"
+#include "../common/gl_state.h"
+#include "../common/gpu_timer.h"
+#include "../common/mesh_registry.h"
+#include "../common/program_cache.h"
+#include "../common/shader_manager.h"
+#include "../common/uniform_buffer.h"
 
 // Program wyświetla 2 trójkąty i 2 prostokąty.
 // Każda figura ma inny kolor i jest animowana.
 // Figury nie wychodzą poza obszar okna dzięki detekcji kolizji i odbiciom (dla Figury 1 i 4).
 
-// Wymiary okna
-const unsigned int SCR_WIDTH  = 800;
-const unsigned int SCR_HEIGHT = 600;
+// Wymiary okna (--size SZERxWYS)
+unsigned int SCR_WIDTH  = 800;
+unsigned int SCR_HEIGHT = 600;
 
 // Vertex shader
 const char* vertexShaderSrc = R"(#version 330 core
 layout(location = 0) in vec3 aPos;
-uniform mat4 uTransform;  // Transformacja modeli
+layout(std140) uniform Figure {
+    mat4 uTransform;  // Transformacja modeli
+    vec4 uColor;      // Kolor figury
+};
 void main() {
     gl_Position = uTransform * vec4(aPos, 1.0);
 }
@@ -25,98 +44,134 @@ void main() {
 // Fragment shader
 const char* fragmentShaderSrc = R"(#version 330 core
 out vec4 FragColor;
-uniform vec4 uColor;  // Kolor figury
+layout(std140) uniform Figure {
+    mat4 uTransform;
+    vec4 uColor;
+};
 void main() { FragColor = uColor; }
 )";
 
-// Kompilacja shadera i sprawdzanie błędów
-unsigned int compileShader(unsigned int type, const char* src) {
-    unsigned int shader = glCreateShader(type);
-    glShaderSource(shader, 1, &src, nullptr);
-    glCompileShader(shader);
-    int success;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        char buf[512];
-        glGetShaderInfoLog(shader, 512, nullptr, buf);
-        std::cerr << "Shader compile error: " << buf << std::endl;
-    }
-    return shader;
-}
-
-int main() {
-    // Inicjalizacja GLFW
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+// Odpowiednik bloku Figure w układzie std140
+struct FigureUniforms {
+    float transform[16];
+    float color[4];
+};
+const unsigned figureBinding = 0;
 
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Animated Shapes", nullptr, nullptr);
-    if (!window) {
-        std::cerr << "Nie można utworzyć okna" << std::endl;
-        glfwTerminate();
-        return -1;
+int main(int argc, char** argv) {
+    // Tempo klatek: --pacing vsync|adaptive|uncapped|<fps>, domyślnie vsync
+    // Bez okna: --headless N renderuje N klatek poza ekranem (build z -DHEADLESS_EGL),
+    // --fixed-dt S przesuwa czas animacji o S sekund na klatkę,
+    // --capture KATALOG zapisuje każdą klatkę jako PPM,
+    // --gpu-timing mierzy czas GPU klatki i każdej figury,
+    // --trace PLIK zapisuje ślad stref CPU dla chrome://tracing (build z -DCPU_PROFILER),
+    // --dynamic-res MS dobiera rozdzielczość renderowania tak, by klatka mieściła się w MS
+    FramePacer pacer;
+    AppWindow window;
+    FrameCapture capture;
+    const char* captureDir = nullptr;
+    GpuTimer gpuTimer;
+    bool gpuTiming = false;
+    const char* tracePath = nullptr;
+    DynamicResolution resolution;
+    double resolutionBudgetMs = 0;
+    std::string shaderCacheDir = ".shader_cache"; // --shader-cache KATALOG|off
+    PROFILE_THREAD("main");
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--pacing") && i + 1 < argc && !pacer.parse(argv[++i]))
+            std::cerr << "Nieznany tryb " << argv[i] << ", używam vsync" << std::endl;
+        else if (!std::strcmp(argv[i], "--headless") && i + 1 < argc)
+            window.setHeadless(std::atol(argv[++i]));
+        else if (!std::strcmp(argv[i], "--fixed-dt") && i + 1 < argc)
+            window.setFixedTimeStep(std::atof(argv[++i]));
+        else if (!std::strcmp(argv[i], "--capture") && i + 1 < argc)
+            captureDir = argv[++i];
+        else if (!std::strcmp(argv[i], "--gpu-timing"))
+            gpuTiming = true;
+        else if (!std::strcmp(argv[i], "--trace") && i + 1 < argc)
+            tracePath = argv[++i];
+        else if (!std::strcmp(argv[i], "--dynamic-res") && i + 1 < argc)
+            resolutionBudgetMs = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "--shader-cache") && i + 1 < argc)
+            shaderCacheDir = std::strcmp(argv[++i], "off") ? argv[i] : "";
+        else if (!std::strcmp(argv[i], "--size") && i + 1 < argc &&
+                 std::sscanf(argv[++i], "%ux%u", &SCR_WIDTH, &SCR_HEIGHT) != 2)
+            std::cerr << "Zły rozmiar " << argv[i] << ", oczekiwano SZERxWYS" << std::endl;
     }
-    glfwMakeContextCurrent(window);
 
-    // Wczytanie funkcji OpenGL
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-        std::cerr << "Nie udało się zainicjalizować GLAD" << std::endl;
+    // Okno GLFW albo kontekst EGL bez okna; w obu przypadkach funkcje OpenGL są już wczytane
+    if (!window.open(SCR_WIDTH, SCR_HEIGHT, "Animated Shapes")) {
+        std::cerr << "Nie można utworzyć okna" << std::endl;
+        window.close();
         return -1;
     }
+    pacer.begin(!window.isHeadless());
+    // Na ekranach high-DPI bufor ramki ma więcej pikseli niż okno punktów
+    SCR_WIDTH = window.framebufferWidth();
+    SCR_HEIGHT = window.framebufferHeight();
+    if (captureDir)
+        capture.start(captureDir, SCR_WIDTH, SCR_HEIGHT);
+    if (gpuTiming)
+        gpuTimer.create();
     glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
 
-    // Budowa programu shaderów
-    unsigned int vs = compileShader(GL_VERTEX_SHADER, vertexShaderSrc);
-    unsigned int fs = compileShader(GL_FRAGMENT_SHADER, fragmentShaderSrc);
-    unsigned int prog = glCreateProgram();
-    glAttachShader(prog, vs);
-    glAttachShader(prog, fs);
-    glLinkProgram(prog);
-    glDeleteShader(vs);
-    glDeleteShader(fs);
+    // Zmiana rozmiaru okna: viewport, cel renderowania i przechwytywanie klatek idą za nim
+    window.onResize = [&](int w, int h) {
+        SCR_WIDTH = w;
+        SCR_HEIGHT = h;
+        glViewport(0, 0, w, h);
+        resolution.resize(w, h);
+        capture.resize(w, h);
+    };
+
+    // Budowa programu shaderów w tle: sterownik kompiluje, a my w tym czasie
+    // przygotowujemy geometrię. Przy kolejnych uruchomieniach gotowy program
+    // wczytywany jest z pamięci podręcznej zamiast kompilacji
+    ShaderManager shaders;
+    shaders.begin();
+    programCache().open(shaderCacheDir);
+    int figureShader = shaders.submit("figure", vertexShaderSrc, fragmentShaderSrc);
+    resolution.create(SCR_WIDTH, SCR_HEIGHT, resolutionBudgetMs, shaders);
 
     // Dane geometrii: trójkąt i prostokąt
+    // Pozycje 2D (z zawsze 0), w buforze zapisane jako znormalizowane GL_SHORT
     float triVertices[] = {
-        0.0f,  0.5f, 0.0f,
-       -0.5f, -0.5f, 0.0f,
-        0.5f, -0.5f, 0.0f
+        0.0f,  0.5f,
+       -0.5f, -0.5f,
+        0.5f, -0.5f
     };
     float rectVertices[] = {
-       -0.5f,  0.5f, 0.0f,
-       -0.5f, -0.5f, 0.0f,
-        0.5f, -0.5f, 0.0f,
-        0.5f,  0.5f, 0.0f
+       -0.5f,  0.5f,
+       -0.5f, -0.5f,
+        0.5f, -0.5f,
+        0.5f,  0.5f
+    };
+    uint16_t triIndices[]  = { 0,1,2 };
+    uint16_t rectIndices[] = { 0,1,2, 0,2,3 };
+
+    // Obie figury we wspólnym buforze wierzchołków i indeksów (jeden VAO)
+    MeshRegistry meshes;
+    int triMesh  = meshes.add(compactPositionFormat, triVertices, 3, triIndices, 3);
+    int rectMesh = meshes.add(compactPositionFormat, rectVertices, 4, rectIndices, 6);
+    meshes.build();
+
+    // Blok uniformów: wszystkie 4 figury w jednym buforze, wysyłane raz na klatkę
+    UniformBlockArray<FigureUniforms> figures;
+    figures.create(figureBinding, 4);
+
+    // Dopiero teraz program jest potrzebny (czekamy, jeśli jeszcze się kompiluje)
+    unsigned int prog;
+    {
+        PROFILE_ZONE("wait for shaders");
+        prog = shaders.program(figureShader);
+    }
+    bindUniformBlock(prog, "Figure", figureBinding);
+    auto setFigure = [&](int i, const glm::mat4& M, float r, float g, float b) {
+        std::memcpy(figures[i].transform, glm::value_ptr(M), sizeof(figures[i].transform));
+        const float color[4] = { r, g, b, 1.0f };
+        std::memcpy(figures[i].color, color, sizeof(color));
     };
-    unsigned int rectIndices[] = { 0,1,2, 0,2,3 };
-
-    // VAO/VBO dla trójkąta
-    unsigned int VAO_tri, VBO_tri;
-    glGenVertexArrays(1, &VAO_tri);
-    glGenBuffers(1, &VBO_tri);
-    glBindVertexArray(VAO_tri);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO_tri);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(triVertices), triVertices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,3*sizeof(float),(void*)0);
-    glEnableVertexAttribArray(0);
-
-    // VAO/VBO/EBO dla prostokąta
-    unsigned int VAO_rect, VBO_rect, EBO_rect;
-    glGenVertexArrays(1,&VAO_rect);
-    glGenBuffers(1,&VBO_rect);
-    glGenBuffers(1,&EBO_rect);
-    glBindVertexArray(VAO_rect);
-    glBindBuffer(GL_ARRAY_BUFFER,VBO_rect);
-    glBufferData(GL_ARRAY_BUFFER,sizeof(rectVertices),rectVertices,GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,EBO_rect);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,sizeof(rectIndices),rectIndices,GL_STATIC_DRAW);
-    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,3*sizeof(float),(void*)0);
-    glEnableVertexAttribArray(0);
-
-    // Lokalizacje uniformów
-    glUseProgram(prog);
-    int locTrans = glGetUniformLocation(prog, "uTransform");
-    int locColor = glGetUniformLocation(prog, "uColor");
+    const int figureMesh[4] = { triMesh, triMesh, rectMesh, rectMesh };
 
     // Parametry animacji i początkowe pozycje
     const float halfTri = 0.5f * 0.6f; // pół rozmiaru trójkąta w skali
@@ -130,84 +185,123 @@ int main() {
     static glm::vec2 pos4( 0.6f,-0.6f);
     static glm::vec2 vel4 = glm::normalize(glm::vec2(-1.0f,0.3f)) * 0.4f;
 
+    // Krok animacji: czas poprzedniej klatki, ograniczony po przestojach
+    // (np. przeciąganie okna), żeby figury nie przeskakiwały przez krawędzie
+    float dt = 0.0f;
+    double prevTime = window.time();
+
     // Pętla główna
-    while (!glfwWindowShouldClose(window)) {
-        float t = (float)glfwGetTime();
+    while (!window.shouldClose()) {
+        float t = (float)window.time();
+        resolution.begin(); // przy --dynamic-res rysujemy do mniejszego bufora
+        gpuTimer.beginFrame();
         glClearColor(0.1f,0.1f,0.1f,1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
-        glUseProgram(prog);
+        glState().useProgram(prog);
 
-        // --- Figura 1 ---
-        // Trójkąt: ruch prostoliniowy z odbiciami od krawędzi okna
+        // Ruch i macierze figur
         {
-            float dt = 0.01f;
-            pos1 += vel1 * dt;
-            // Odbicie w poziomie
-            if (pos1.x + halfTri > 1.0f || pos1.x - halfTri < -1.0f) vel1.x *= -1;
-            // Odbicie w pionie
-            if (pos1.y + halfTri > 1.0f || pos1.y - halfTri < -1.0f) vel1.y *= -1;
-            glm::mat4 M = glm::translate(glm::mat4(1.0f), glm::vec3(pos1,0.0f));
-            M = glm::scale(M, glm::vec3(0.6f));
-            glUniformMatrix4fv(locTrans,1,GL_FALSE,glm::value_ptr(M));
-            glUniform4f(locColor,1.0f,0.0f,0.0f,1.0f);
-            glBindVertexArray(VAO_tri);
-            glDrawArrays(GL_TRIANGLES,0,3);
+            PROFILE_ZONE("update");
+
+            // --- Figura 1 ---
+            // Trójkąt: ruch prostoliniowy z odbiciami od krawędzi okna
+            {
+                pos1 += vel1 * dt;
+                // Odbicie w poziomie
+                if (pos1.x + halfTri > 1.0f || pos1.x - halfTri < -1.0f) vel1.x *= -1;
+                // Odbicie w pionie
+                if (pos1.y + halfTri > 1.0f || pos1.y - halfTri < -1.0f) vel1.y *= -1;
+                glm::mat4 M = glm::translate(glm::mat4(1.0f), glm::vec3(pos1,0.0f));
+                M = glm::scale(M, glm::vec3(0.6f));
+                setFigure(0, M, 1.0f, 0.0f, 0.0f);
+            }
+
+            // --- Figura 2 ---
+            // Trójkąt: stała rotacja w miejscu (górny prawy)
+            {
+                glm::mat4 M = glm::translate(glm::mat4(1.0f), glm::vec3(0.6f,0.6f,0.0f));
+                M = glm::rotate(M, t, glm::vec3(0,0,1));
+                M = glm::scale(M, glm::vec3(0.6f));
+                setFigure(1, M, 0.0f, 1.0f, 0.0f);
+            }
+
+            // --- Figura 3 ---
+            // Prostokąt: pulsacyjne powiększanie i zmniejszanie (dolny lewy)
+            {
+                float s = 0.4f + sin(t*2.0f)*0.1f;
+                glm::mat4 M = glm::translate(glm::mat4(1.0f), glm::vec3(-0.6f,-0.6f,0.0f));
+                M = glm::scale(M, glm::vec3(s));
+                setFigure(2, M, 0.0f, 0.0f, 1.0f);
+            }
+
+            // --- Figura 4 ---
+            // Prostokąt: łączona animacja ruchu z odbiciami, rotacji i skali
+            {
+                pos4 += vel4 * dt;
+                if (pos4.x + halfRec > 1.0f || pos4.x - halfRec < -1.0f) vel4.x *= -1;
+                if (pos4.y + halfRec > 1.0f || pos4.y - halfRec < -1.0f) vel4.y *= -1;
+                float sc = 0.4f + cos(t)*0.1f;
+                glm::mat4 M = glm::translate(glm::mat4(1.0f), glm::vec3(pos4,0.0f));
+                M = glm::rotate(M, t, glm::vec3(0,0,1));
+                M = glm::scale(M, glm::vec3(sc));
+                setFigure(3, M, 1.0f, 1.0f, 0.0f);
+            }
         }
 
-        // --- Figura 2 ---
-        // Trójkąt: stała rotacja w miejscu (górny prawy)
+        // Jeden zapis bufora uniformów, potem rysowanie figur
         {
-            glm::mat4 M = glm::translate(glm::mat4(1.0f), glm::vec3(0.6f,0.6f,0.0f));
-            M = glm::rotate(M, t, glm::vec3(0,0,1));
-            M = glm::scale(M, glm::vec3(0.6f));
-            glUniformMatrix4fv(locTrans,1,GL_FALSE,glm::value_ptr(M));
-            glUniform4f(locColor,0.0f,1.0f,0.0f,1.0f);
-            glBindVertexArray(VAO_tri);
-            glDrawArrays(GL_TRIANGLES,0,3);
+            PROFILE_ZONE("uniforms");
+            figures.upload(4);
         }
-
-        // --- Figura 3 ---
-        // Prostokąt: pulsacyjne powiększanie i zmniejszanie (dolny lewy)
         {
-            float s = 0.4f + sin(t*2.0f)*0.1f;
-            glm::mat4 M = glm::translate(glm::mat4(1.0f), glm::vec3(-0.6f,-0.6f,0.0f));
-            M = glm::scale(M, glm::vec3(s));
-            glUniformMatrix4fv(locTrans,1,GL_FALSE,glm::value_ptr(M));
-            glUniform4f(locColor,0.0f,0.0f,1.0f,1.0f);
-            glBindVertexArray(VAO_rect);
-            glDrawElements(GL_TRIANGLES,6,GL_UNSIGNED_INT,0);
+            PROFILE_ZONE("draw");
+            static const char* figureZone[4] = { "figure 1", "figure 2", "figure 3", "figure 4" };
+            for (int i = 0; i < 4; ++i) {
+                GpuZone zone(gpuTimer, figureZone[i]); // czas GPU rysowania figury
+                figures.bind(i);
+                meshes.draw(figureMesh[i]);
+            }
         }
-
-        // --- Figura 4 ---
-        // Prostokąt: łączona animacja ruchu z odbiciami, rotacji i skali
+        gpuTimer.endFrame();
         {
-            float dt = 0.01f;
-            pos4 += vel4 * dt;
-            if (pos4.x + halfRec > 1.0f || pos4.x - halfRec < -1.0f) vel4.x *= -1;
-            if (pos4.y + halfRec > 1.0f || pos4.y - halfRec < -1.0f) vel4.y *= -1;
-            float sc = 0.4f + cos(t)*0.1f;
-            glm::mat4 M = glm::translate(glm::mat4(1.0f), glm::vec3(pos4,0.0f));
-            M = glm::rotate(M, t, glm::vec3(0,0,1));
-            M = glm::scale(M, glm::vec3(sc));
-            glUniformMatrix4fv(locTrans,1,GL_FALSE,glm::value_ptr(M));
-            glUniform4f(locColor,1.0f,1.0f,0.0f,1.0f);
-            glBindVertexArray(VAO_rect);
-            glDrawElements(GL_TRIANGLES,6,GL_UNSIGNED_INT,0);
+            PROFILE_ZONE("upscale");
+            resolution.end(); // skalowanie do rozmiaru okna
         }
 
         // Zamiana buforów i przetwarzanie zdarzeń
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        {
+            PROFILE_ZONE("capture");
+            capture.capture(window.frameCount()); // odczyt asynchroniczny, zapis w osobnym wątku
+        }
+        {
+            PROFILE_ZONE("swap");
+            window.swapBuffers();
+        }
+        PROFILE_FRAME();
+        resolution.endFrame(gpuTimer.enabled() ? gpuTimer.lastFrameMs() : 0.0);
+        pacer.endFrame();
+        double now = window.time(); // przy --fixed-dt stały krok niezależny od szybkości renderowania
+        dt = std::min((float)(now - prevTime), 0.1f);
+        prevTime = now;
+        glState().endFrame(); // liczniki wywołań wykonanych i pominiętych
+        PROFILE_ZONE("events");
+        window.pollEvents();
     }
 
     // Sprzątanie
-    glDeleteVertexArrays(1,&VAO_tri);
-    glDeleteBuffers(1,&VBO_tri);
-    glDeleteVertexArrays(1,&VAO_rect);
-    glDeleteBuffers(1,&VBO_rect);
-    glDeleteBuffers(1,&EBO_rect);
+    meshes.destroy();
+    figures.destroy();
+    resolution.destroy();
     glDeleteProgram(prog);
-    glfwDestroyWindow(window);
-    glfwTerminate();
+    capture.finish();
+    gpuTimer.finish();
+    window.close();
+    pacer.printStats(std::cout);
+    gpuTimer.printStats(std::cout, pacer.stats());
+    resolution.printStats(std::cout);
+    shaders.printStats(std::cout);
+    programCache().printStats(std::cout);
+    capture.printStats(std::cout);
+    cpuProfilerReport(tracePath, std::cout);
     return 0;
 }